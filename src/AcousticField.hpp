@@ -0,0 +1,238 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <deque>
+#include <math.h>
+#include <SDL.h>
+
+#include "Wave.hpp"
+#include "TileGrid.hpp"
+#include "Profiler.hpp"
+
+//How far a default wave carries before it fades out: 100 px/s for 255/100 s
+#define SOUND_RANGE 255
+
+//Chamfer steps for the distance transform, an orthogonal cell is 5 and a diagonal 7
+#define ACOUSTIC_ORTHOGONAL 5
+#define ACOUSTIC_DIAGONAL 7
+#define ACOUSTIC_UNREACHED 255
+
+using namespace std;
+
+//How sound gets around the level's walls, computed as tiles arrive so gameplay never has to simulate a wave.
+//Every open cell in the active part of the level is a source: a distance transform around it stores the
+//shortest path through open cells to every cell within range, so path length, attenuation and audibility
+//between two points are one lookup. Only the grid's loaded chunks are active, and only they keep anything per cell
+class AcousticField:public SoundListener{
+	TileGrid *grid;
+	int cols, rows, cellSize;
+	double range;
+	double listenerX, listenerY;
+
+	int radius; //cells of path reachable within range
+	int span; //width of each source's window, 2*radius+1
+
+	ChunkCells<int> windowOf; //cell -> first byte of its window, -1 for solid or inactive cells
+	vector<unsigned char> paths; //chamfer path length from a source to each cell of its window
+	vector<int> freeWindows;
+	deque<int> dirty; //sources waiting for refresh to transform them again
+	ChunkCells<char> queued;
+	vector<pair<int,int> > frontier; //min-heap of (path, window cell), reused across sources
+
+	bool open(int c, int r){
+		Tile *t = grid->at(c, r);
+		return c>=0 && c<cols && r>=0 && r<rows && !(t && t->isSolid());
+	}
+
+	void transform(int source){
+		int sc = source%cols, sr = source/cols;
+		unsigned char *window = &paths[windowOf.get(sc, sr)];
+		int limit = radius*ACOUSTIC_ORTHOGONAL;
+
+		greater<pair<int,int> > later;
+
+		frontier.clear();
+		window[radius*span+radius] = 0;
+		frontier.push_back(make_pair(0, radius*span+radius));
+
+		while(!frontier.empty()){
+			pop_heap(frontier.begin(), frontier.end(), later);
+			int d = frontier.back().first, w = frontier.back().second;
+			frontier.pop_back();
+			if(d > window[w]) continue;
+
+			int wc = w%span, wr = w/span;
+			int c = sc+wc-radius, r = sr+wr-radius;
+
+			for(int dr=-1; dr<=1; dr++){
+				for(int dc=-1; dc<=1; dc++){
+					if(dc==0 && dr==0) continue;
+
+					int nwc = wc+dc, nwr = wr+dr;
+					if(nwc<0 || nwc>=span || nwr<0 || nwr>=span || !open(c+dc, r+dr)) continue;
+
+					//Sound does not squeeze between two diagonal tiles
+					if(dc!=0 && dr!=0 && (!open(c+dc, r) || !open(c, r+dr))) continue;
+
+					int nd = d + (dc!=0 && dr!=0 ? ACOUSTIC_DIAGONAL : ACOUSTIC_ORTHOGONAL);
+					int nw = nwr*span+nwc;
+					if(nd > limit || nd >= window[nw]) continue;
+
+					window[nw] = nd;
+					frontier.push_back(make_pair(nd, nw));
+					push_heap(frontier.begin(), frontier.end(), later);
+				}
+			}
+		}
+	}
+
+	int cellAt(double x, double y){
+		int c = grid->colOf(x), r = grid->rowOf(y);
+		if(c<0 || c>=cols || r<0 || r>=rows) return -1;
+
+		//Sounds made on a tile's surface come from the open cell above it
+		if(!open(c, r) && open(c, r-1)) r--;
+
+		return r*cols+c;
+	}
+
+	public:
+	AcousticField(TileGrid *newGrid, double newRange=SOUND_RANGE):windowOf(-1), queued(false){
+		grid = newGrid;
+		cols = grid->getCols();
+		rows = grid->getRows();
+		cellSize = grid->getCellSize();
+		range = newRange;
+		listenerX = 0;
+		listenerY = 0;
+
+		radius = min(ACOUSTIC_UNREACHED/ACOUSTIC_ORTHOGONAL-1, (int)ceil(range/cellSize));
+		span = 2*radius+1;
+
+		windowOf.resize(cols, rows);
+		queued.resize(cols, rows);
+	}
+
+	//Transforms every source in the loaded chunks at once
+	void build(){
+		PROFILE_SCOPE("AcousticField::build");
+
+		tilesChanged(0, 0, cols-1, rows-1);
+		refresh();
+	}
+
+	//Tiles in the cells c0..c1, r0..r1 changed, were loaded or were unloaded. Every loaded source within range
+	//of them is queued for refresh, until then queries use its old paths
+	void tilesChanged(int c0, int r0, int c1, int r1){
+		for(int r=max(0, r0-radius); r<=min(rows-1, r1+radius); r++){
+			for(int c=max(0, c0-radius); c<=min(cols-1, c1+radius); c++){
+				if(!grid->isLoaded(c, r) || queued.get(c, r)) continue;
+
+				queued.at(c, r) = true;
+				dirty.push_back(r*cols+c);
+			}
+		}
+	}
+
+	//The grid has unloaded the chunk holding cell (c, r), its sources give their windows back
+	void unloadChunk(int c, int r){
+		int c0 = c-c%CHUNK_TILES, r0 = r-r%CHUNK_TILES;
+
+		for(int wr=r0; wr<min(rows, r0+CHUNK_TILES); wr++)
+			for(int wc=c0; wc<min(cols, c0+CHUNK_TILES); wc++)
+				if(windowOf.get(wc, wr) >= 0) freeWindows.push_back(windowOf.get(wc, wr));
+
+		windowOf.unload(c, r);
+		queued.unload(c, r);
+	}
+
+	//Transforms up to maxCells queued sources, all of them when maxCells is negative. Sources no longer
+	//open give their window back
+	void refresh(int maxCells=-1){
+		if(dirty.empty()) return;
+
+		PROFILE_SCOPE("AcousticField::refresh");
+
+		for(int n=0; !dirty.empty() && (maxCells < 0 || n < maxCells); n++){
+			int cell = dirty.front();
+			dirty.pop_front();
+
+			//Unloading its chunk gave its window back already
+			int c = cell%cols, r = cell/cols;
+			if(!grid->isLoaded(c, r)) continue;
+
+			queued.at(c, r) = false;
+			int &window = windowOf.at(c, r);
+
+			if(!open(c, r)){
+				if(window >= 0) freeWindows.push_back(window);
+				window = -1;
+				continue;
+			}
+
+			if(window < 0){
+				if(freeWindows.empty()){
+					window = paths.size();
+					paths.resize(paths.size()+span*span);
+				} else {
+					window = freeWindows.back();
+					freeWindows.pop_back();
+				}
+			}
+
+			fill(paths.begin()+window, paths.begin()+window+span*span, ACOUSTIC_UNREACHED);
+			transform(cell);
+		}
+	}
+
+	bool isSettled(){ return dirty.empty(); }
+
+	//Length in pixels of the shortest path sound can take between two points, or -1 when walls keep it
+	//out of range. Points outside the level or its active part have nothing known in the way and use the straight line
+	double pathLength(double sx, double sy, double lx, double ly){
+		int source = cellAt(sx, sy), listener = cellAt(lx, ly);
+
+		if(source < 0 || listener < 0 || !grid->isLoaded(source%cols, source/cols) || !grid->isLoaded(listener%cols, listener/cols)){
+			double straight = hypot(lx-sx, ly-sy);
+			return straight <= range ? straight : -1;
+		}
+
+		int window = windowOf.get(source%cols, source/cols);
+		if(window < 0 || windowOf.get(listener%cols, listener/cols) < 0) return -1;
+
+		int dc = listener%cols - source%cols, dr = listener/cols - source/cols;
+		if(abs(dc) > radius || abs(dr) > radius) return -1;
+
+		int d = paths[window + (dr+radius)*span + dc+radius];
+		if(d == ACOUSTIC_UNREACHED) return -1;
+
+		double length = (double)d*cellSize/ACOUSTIC_ORTHOGONAL;
+		return length <= range ? length : -1;
+	}
+
+	//Loudness from 1 at the source to 0 at the end of its path, falling linearly like a wave's brightness
+	double attenuation(double sx, double sy, double lx, double ly){
+		double length = pathLength(sx, sy, lx, ly);
+		if(length < 0) return 0;
+
+		return 1-length/range;
+	}
+
+	bool audibleAt(double sx, double sy, double lx, double ly, double threshold=0){
+		return attenuation(sx, sy, lx, ly) > threshold;
+	}
+
+	//Where volumeAt listens from, normally the player's ears
+	void setListener(double x, double y){
+		listenerX = x;
+		listenerY = y;
+	}
+
+	double volumeAt(double x, double y){
+		return attenuation(x, y, listenerX, listenerY);
+	}
+
+	size_t bytes(){ return paths.size() + windowOf.bytes() + queued.bytes(); }
+};
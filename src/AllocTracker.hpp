@@ -0,0 +1,225 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+using namespace std;
+
+enum AllocTag{ALLOC_OTHER, ALLOC_WAVES, ALLOC_TILES, ALLOC_ENTITIES, ALLOC_PLAYER, ALLOC_ANIMATION, ALLOC_CONFIG, ALLOC_MEDIA, ALLOC_LEVEL, ALLOC_FRAME, ALLOC_TAG_COUNT};
+
+static const char *allocTagNames[ALLOC_TAG_COUNT] = {"other", "waves", "tiles", "entities", "player", "animation", "config", "media", "level", "frame"};
+
+#define ALLOC_WARMUP_TICKS 120 //ticks into a level before an allocation inside a tick is flagged
+#define ALLOC_FLAGS_KEPT 16
+
+struct AllocFlag{
+	long tick;
+	AllocTag tag;
+	size_t size;
+};
+
+//Heap use per subsystem: allocations, live bytes and peak bytes, plus allocations made inside each tick once a
+//level has settled, which should be none. Allocations are charged to the innermost ALLOC_SCOPE on their thread.
+//Only builds with TRACK_ALLOCATIONS (make memory) hook operator new, and then only count once enabled with memory=1.
+//Everywhere else a scope costs two thread local writes
+class AllocTracker{
+	atomic<bool> enabled;
+	atomic<long> allocs[ALLOC_TAG_COUNT], live[ALLOC_TAG_COUNT], peak[ALLOC_TAG_COUNT];
+
+	//Physics thread only, between beginTick and endTick
+	atomic<long> tickAllocs;
+	long ticks, steadyTicks, steadyAllocs, worstTick, worstTickAllocs;
+
+	//The first allocations made inside a settled tick, kept in place since the hook itself must not allocate
+	AllocFlag flags[ALLOC_FLAGS_KEPT];
+	atomic<long> flagged;
+
+	AllocTracker(){
+		enabled = false;
+		for(int i=0; i<ALLOC_TAG_COUNT; i++){
+			allocs[i] = 0;
+			live[i] = 0;
+			peak[i] = 0;
+		}
+
+		resetLevel();
+	}
+
+	AllocTag &threadTag(){
+		static thread_local AllocTag tag = ALLOC_OTHER;
+		return tag;
+	}
+
+	bool &threadInTick(){
+		static thread_local bool inTick = false;
+		return inTick;
+	}
+
+	public:
+	static AllocTracker &get(){
+		static AllocTracker tracker;
+		return tracker;
+	}
+
+	static bool isAvailable(){
+#ifdef TRACK_ALLOCATIONS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	bool isEnabled(){ return enabled; }
+	void setEnabled(bool newEnabled){ enabled = newEnabled && isAvailable(); }
+
+	AllocTag enter(AllocTag tag){
+		AllocTag outer = threadTag();
+		threadTag() = tag;
+
+		return outer;
+	}
+
+	void leave(AllocTag outer){ threadTag() = outer; }
+
+	//From operator new. The tag returned is stored with the block and handed back to freed, -1 when not counted
+	int allocated(size_t size){
+		if(!enabled) return -1;
+
+		AllocTag tag = threadTag();
+		allocs[tag]++;
+
+		long now = live[tag] += size;
+		for(long old = peak[tag]; now > old && !peak[tag].compare_exchange_weak(old, now);){}
+
+		if(threadInTick()){
+			tickAllocs++;
+
+			if(ticks >= ALLOC_WARMUP_TICKS){
+				long i = flagged++;
+				if(i < ALLOC_FLAGS_KEPT) flags[i] = {ticks, tag, size};
+			}
+		}
+
+		return tag;
+	}
+
+	void freed(int tag, size_t size){
+		if(tag >= 0) live[tag] -= size;
+	}
+
+	void beginTick(){
+		if(!enabled) return;
+
+		threadInTick() = true;
+		tickAllocs = 0;
+	}
+
+	void endTick(){
+		if(!enabled) return;
+
+		threadInTick() = false;
+
+		if(ticks >= ALLOC_WARMUP_TICKS){
+			steadyTicks++;
+			steadyAllocs += tickAllocs;
+
+			if(tickAllocs > worstTickAllocs){
+				worstTick = ticks;
+				worstTickAllocs = tickAllocs;
+			}
+		}
+
+		ticks++;
+	}
+
+	//Starts the per-level figures over. Peaks restart from what is live now
+	void resetLevel(){
+		for(int i=0; i<ALLOC_TAG_COUNT; i++){
+			allocs[i] = 0;
+			peak[i] = live[i].load();
+		}
+
+		tickAllocs = 0;
+		ticks = 0;
+		steadyTicks = 0;
+		steadyAllocs = 0;
+		worstTick = -1;
+		worstTickAllocs = 0;
+		flagged = 0;
+	}
+
+	void report(ostream &out, string title){
+		//Copied first, the report's own strings must not show up in it
+		long counts[ALLOC_TAG_COUNT], liveNow[ALLOC_TAG_COUNT], peaks[ALLOC_TAG_COUNT];
+		for(int i=0; i<ALLOC_TAG_COUNT; i++){
+			counts[i] = allocs[i];
+			liveNow[i] = live[i];
+			peaks[i] = peak[i];
+		}
+		long flagsSeen = flagged;
+
+		out << "Memory: " << title << ", " << ticks << " ticks" << endl;
+		out << left << setw(12) << "subsystem" << right << setw(12) << "allocs" << setw(12) << "live KB" << setw(12) << "peak KB" << endl;
+
+		for(int i=0; i<ALLOC_TAG_COUNT; i++){
+			out << left << setw(12) << allocTagNames[i] << right << setw(12) << counts[i]
+				<< setw(12) << fixed << setprecision(1) << liveNow[i]/1024.0 << setw(12) << peaks[i]/1024.0 << endl;
+		}
+
+		out << "Settled ticks (after " << ALLOC_WARMUP_TICKS << "): " << steadyTicks << ", allocations in them: " << steadyAllocs;
+		if(worstTickAllocs > 0) out << ", worst tick " << worstTick << " with " << worstTickAllocs;
+		out << endl;
+
+		for(long i=0; i<flagsSeen && i<ALLOC_FLAGS_KEPT; i++)
+			out << "  tick " << flags[i].tick << ": " << flags[i].size << " bytes in " << allocTagNames[flags[i].tag] << endl;
+		if(flagsSeen > ALLOC_FLAGS_KEPT) out << "  and " << flagsSeen-ALLOC_FLAGS_KEPT << " more" << endl;
+	}
+};
+
+//Charges allocations on this thread to tag until the end of the enclosing block
+struct AllocScope{
+	AllocTag outer;
+
+	AllocScope(AllocTag tag){ outer = AllocTracker::get().enter(tag); }
+	~AllocScope(){ AllocTracker::get().leave(outer); }
+};
+
+#define ALLOC_CONCAT_INNER(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_INNER(a, b)
+#define ALLOC_SCOPE(tag) AllocScope ALLOC_CONCAT(allocScope, __LINE__)(tag)
+
+#ifdef TRACK_ALLOCATIONS
+//Every block carries its size and tag in front of it so frees can be charged back. Only the game's main file may
+//include this with TRACK_ALLOCATIONS defined, since it replaces the global operator new
+struct alignas(16) AllocHeader{
+	size_t size;
+	int tag;
+};
+
+void *operator new(size_t size){
+	AllocHeader *h = (AllocHeader *)malloc(sizeof(AllocHeader) + size);
+	if(h == NULL) throw bad_alloc();
+
+	h->size = size;
+	h->tag = AllocTracker::get().allocated(size);
+
+	return h+1;
+}
+
+void operator delete(void *p) noexcept{
+	if(p == NULL) return;
+
+	AllocHeader *h = (AllocHeader *)p - 1;
+	AllocTracker::get().freed(h->tag, h->size);
+	free(h);
+}
+
+void *operator new[](size_t size){ return operator new(size); }
+void operator delete[](void *p) noexcept{ operator delete(p); }
+void operator delete(void *p, size_t) noexcept{ operator delete(p); }
+void operator delete[](void *p, size_t) noexcept{ operator delete(p); }
+#endif
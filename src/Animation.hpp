@@ -5,40 +5,18 @@
 
 using namespace std;
 
-class AnimationFrame{
-	SDL_Rect frame;
-	int millis;
-    
-	public:
-	AnimationFrame(int newMillis, int newX, int newY, int newW, int newH){
-		millis=newMillis;
-		frame.x = newX;
-		frame.y = newY;
-		frame.w = newW;
-		frame.h = newH;
-	}
-
-	int getMillis(){ return millis; }
-
-	SDL_Rect *getFrame(){ return &frame; }
-};
-
+//Plays an AnimationSheet from the MediaManager. The frames are shared, only the time and alpha are this Animation's
 class Animation{
-	SDL_Texture *spriteSheet;
-	vector<AnimationFrame*> frames;
+	AnimationSheet *sheet;
 
-	int totalTime;
 	int currentTime;
 
-	string sheetName;
-	string animationFile;
-
-	//controls all texture transparency
+	//alpha every frame of this animation is drawn with
 	int transparency;
 
 	public:
 	Animation(int newTransparency=255){ 
-	  totalTime = 0;
+	  sheet = NULL;
 	  currentTime = 0;
 	  transparency = newTransparency;
 	}
@@ -47,69 +25,43 @@ class Animation{
 
 	void setTransparency(int newTransparency){ 
 		transparency = newTransparency;
-
-		SDL_SetTextureAlphaMod(spriteSheet, transparency);
 	}
 
 	void decTransparency(int decrement){ 
 		transparency -= decrement;
-
-		SDL_SetTextureAlphaMod(spriteSheet, transparency);
 	}
 
 	void readAnimation(MediaManager *media,string newAnimationFile){
-		newAnimationFile = "media/animations/" + newAnimationFile + ".txt";
-
-		if(newAnimationFile != animationFile){
-			animationFile = newAnimationFile;
-
-			int max;
-			ifstream in;
-
-			in.open(animationFile);
-			in >> max >> sheetName;
-
-			spriteSheet = media->readImage(sheetName);
-			SDL_SetTextureAlphaMod(spriteSheet, transparency);
-
-			int millis,x,y,w,h;
-
-			for (int i=0;i<max;i++){
-				in >> millis >> x >> y >> w >> h;
-				AnimationFrame *af = new AnimationFrame(millis, x, y, w, h);
-				
-				frames.push_back(af);
-				totalTime += af->getMillis(); 
-			}
-
-			in.close();
-		}	
+		sheet = media->readAnimation(newAnimationFile);
 	}
 
 	void update(double dt){
 		currentTime += (int)(dt*1000.0);
-		currentTime %= totalTime;
+		currentTime %= sheet->totalTime;
 	}
 
-	SDL_Rect *getFrame(){
+	SDL_Rect *getFrame(){ return getFrame(currentTime); }
+
+	//Frame at an externally kept time, so one Animation can be shared by many entities
+	SDL_Rect *getFrame(int time){
 		int checkTime = 0;
 		int t = 0;
 
-		for (t=0;t<frames.size();t++){
-			if (checkTime+frames[t]->getMillis()>currentTime) 
+		for (t=0;t<sheet->frames.size();t++){
+			if (checkTime+sheet->millis[t]>time) 
 			  break;
-			checkTime += frames[t]->getMillis();
+			checkTime += sheet->millis[t];
 		}
 		
-		if (t==frames.size()) t = 0;
+		if (t==sheet->frames.size()) t = 0;
 
-		return frames[t]->getFrame();
+		return &sheet->frames[t];
 	}
 
-	SDL_Texture *getTexture(){ return spriteSheet; }
-
-	~Animation(){
-		for (auto f:frames) 
-		  delete f;
+	//Advances an externally kept time the same way update() advances the animation's own
+	int advance(int time, double dt){
+		return (time + (int)(dt*1000.0)) % sheet->totalTime;
 	}
-};
\ No newline at end of file
+
+	SDL_Texture *getTexture(){ return sheet->texture; }
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+//Every allocation in the benchmark binary is counted so allocs/op can be reported next to ns/op.
+//This header replaces the global operator new and must only be included by the benchmark's main file.
+static atomic<long> benchAllocations(0);
+
+void *operator new(size_t size){
+	benchAllocations++;
+
+	void *p = malloc(size ? size : 1);
+	if(p == NULL) throw bad_alloc();
+
+	return p;
+}
+
+void *operator new[](size_t size){ return operator new(size); }
+void operator delete(void *p) noexcept{ free(p); }
+void operator delete[](void *p) noexcept{ free(p); }
+void operator delete(void *p, size_t) noexcept{ free(p); }
+void operator delete[](void *p, size_t) noexcept{ free(p); }
+
+class Bench{
+	string filter;
+	double minSeconds;
+
+	static double now(){
+		return double(SDL_GetPerformanceCounter())/SDL_GetPerformanceFrequency();
+	}
+
+	public:
+	Bench(string newFilter="", double newMinSeconds=0.2){
+		filter = newFilter;
+		minSeconds = newMinSeconds;
+
+		cout << left << setw(32) << "benchmark" << right << setw(8) << "size" << setw(12) << "iters"
+			<< setw(14) << "ns/op" << setw(12) << "allocs/op" << endl;
+	}
+
+	bool enabled(string name){
+		return filter.empty() || name.find(filter) != string::npos;
+	}
+
+	//Runs op in doubling batches until a batch takes at least minSeconds, then reports that batch.
+	//size is only a label for scaling curves, the op itself owns whatever state it needs.
+	template<typename Op>
+	void run(string name, int size, Op op){
+		if(!enabled(name)) return;
+
+		op(); //warm caches and lazy loads before timing
+
+		long iterations = 1;
+		double elapsed = 0;
+		long allocations = 0;
+
+		while(true){
+			long startAllocations = benchAllocations;
+			double start = now();
+
+			for(long i=0; i<iterations; i++) op();
+
+			elapsed = now()-start;
+			allocations = benchAllocations-startAllocations;
+
+			if(elapsed >= minSeconds || iterations >= (1L<<30)) break;
+			iterations *= 2;
+		}
+
+		cout << left << setw(32) << name << right << setw(8) << size << setw(12) << iterations
+			<< setw(14) << fixed << setprecision(1) << elapsed*1e9/iterations
+			<< setw(12) << setprecision(2) << double(allocations)/iterations << endl;
+	}
+};
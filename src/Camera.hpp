@@ -0,0 +1,51 @@
+#pragma once
+
+#include <SDL.h>
+
+using namespace std;
+
+//The window's view into a level of any size. Everything in the world is stored in level pixels
+//and shifted by the camera only when it is drawn
+class Camera{
+	int x, y;
+	int viewW, viewH;
+
+	public:
+	Camera(int newViewW=1280, int newViewH=720){
+		x = 0;
+		y = 0;
+		viewW = newViewW;
+		viewH = newViewH;
+	}
+
+	int getX(){ return x; }
+	int getY(){ return y; }
+	int getViewW(){ return viewW; }
+	int getViewH(){ return viewH; }
+
+	//Centres the view on target without showing past the edges of a worldW x worldH level.
+	//A level smaller than the view stays pinned to the top left, as every level was before scrolling
+	void follow(SDL_Rect *target, int worldW, int worldH){
+		x = target->x + target->w/2 - viewW/2;
+		y = target->y + target->h/2 - viewH/2;
+
+		if(x > worldW-viewW) x = worldW-viewW;
+		if(y > worldH-viewH) y = worldH-viewH;
+		if(x < 0) x = 0;
+		if(y < 0) y = 0;
+	}
+
+	SDL_Rect view(){
+		SDL_Rect v = {x, y, viewW, viewH};
+		return v;
+	}
+
+	bool visible(SDL_Rect *world){
+		return world->x+world->w > x && world->x < x+viewW && world->y+world->h > y && world->y < y+viewH;
+	}
+
+	SDL_Rect toScreen(SDL_Rect *world){
+		SDL_Rect screen = {world->x-x, world->y-y, world->w, world->h};
+		return screen;
+	}
+};
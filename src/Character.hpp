@@ -10,6 +10,12 @@
 #include "Config.hpp"
 #include "Wave.hpp"
 #include "Tile.hpp"
+#include "TileGrid.hpp"
+#include "Profiler.hpp"
+#include "AllocTracker.hpp"
+#include "Camera.hpp"
+#include "DrawList.hpp"
+#include "Names.hpp"
 
 #define GRAVITY 300
 
@@ -22,11 +28,14 @@ class Character:public Particle{
 	SDL_Renderer *ren;
 	MediaManager *media;
 
-	map<string,Animation *> animations;
-	map<string,Mix_Chunk *> sounds;
+	NameTable<Animation *> animations;
+	Animation *defaultAnimation;
+	NameTable<Mix_Chunk *> sounds;
+	WaveProfile *footstep, *clapWave;
 
 	double baseSpeed, jumpSpeed;
-	int timeMoving;
+	double moveDt; //dt of the last update, the move itself happens in collisions()
+	double timeMoving; //s walked since the last footstep
 	direction dir;
 	bool clapped, inAir, onTile, hasKey, unlocked, hasLeft;
 
@@ -49,6 +58,7 @@ class Character:public Particle{
 		cfg = newCfg;
 		waves = newWaves;
 		timeMoving = 0;
+		moveDt = 0;
 		inAir = true;
 		dir = STOP;
 		clapped = false;
@@ -71,18 +81,34 @@ class Character:public Particle{
 		vector<string> newAnimations = cfg->getMany("animations");
 
 		for(auto anim: newAnimations){
-			animations[anim] = new Animation();
-			animations[anim]->readAnimation(media, anim);
+			Animation *newA = new Animation();
+			newA->readAnimation(media, anim);
+			animations.set(Names::get().id(anim), newA);
 		}
 
-		a=animations[(*cfg)["defaultAnimation"]];
+		defaultAnimation = animations[Names::get().id((*cfg)["defaultAnimation"])];
+		a = defaultAnimation;
 		
 		vector<string> newSounds = cfg->getMany("sounds");
 
 		for(auto sound: newSounds){
-			sounds[sound] = new Mix_Chunk();
-			sounds[sound] = media->readSound(sound);
+			sounds.set(Names::get().id(sound), media->readSound(sound));
 		}
+
+		footstep = waves->profile("footstep");
+		clapWave = waves->profile("clap");
+	}
+
+	//Picks up a reloaded config. The size stays as built so the character never ends up inside a tile
+	void configure(){
+		baseSpeed = stod((*cfg)["baseSpeed"]);
+		jumpSpeed = stod((*cfg)["jumpSpeed"]);
+
+		int name = Names::get().id((*cfg)["defaultAnimation"]);
+		if(animations.has(name)) defaultAnimation = animations[name];
+
+		if(dir==RIGHT) vx = baseSpeed;
+		else if(dir==LEFT) vx = -baseSpeed;
 	}
 
 	//Basic Getters
@@ -101,10 +127,10 @@ class Character:public Particle{
 			theta = 0;
 
 			if(onTile){
-				waves->createWave(sounds["footstep"], x+dest.w/2, y+dest.h);
+				waves->createWave(footstep, x+dest.w/2, y+dest.h);
 			}
 
-			setAnimation(animations["walkRight"]);
+			setAnimation(animations[NAME_WALK_RIGHT]);
 		}
 	}
 
@@ -115,10 +141,10 @@ class Character:public Particle{
 			theta = 180;
 
 			if(onTile){
-				waves->createWave(sounds["footstep"], x+dest.w/4, y+dest.h);
+				waves->createWave(footstep, x+dest.w/4, y+dest.h);
 			}
 
-			setAnimation(animations["walkLeft"]);
+			setAnimation(animations[NAME_WALK_LEFT]);
 		}
 	}
 
@@ -128,7 +154,7 @@ class Character:public Particle{
 			vx = 0;
 			timeMoving = 0;
 
-			setAnimation(animations[(*cfg)["defaultAnimation"]]);
+			setAnimation(defaultAnimation);
 		}
 	}
 
@@ -140,8 +166,9 @@ class Character:public Particle{
 	}
 	void collectedKey(){
 		hasKey = true;
-		Mix_PlayChannel(-1,sounds["key"],0);
+		media->playSound(sounds[NAME_KEY]);
 	}
+	bool getHasKey(){ return hasKey; }
 	bool leftTheBuilding(){
 		return hasLeft;
 	}
@@ -158,20 +185,20 @@ class Character:public Particle{
 		timeMoving = 0;
 
 		if (vx>0){
-			waves->createWave(sounds["footstep"], x+dest.w/2, y+(dest.h-3));
-			setAnimation(animations["walkRight"]);
+			waves->createWave(footstep, x+dest.w/2, y+(dest.h-3));
+			setAnimation(animations[NAME_WALK_RIGHT]);
 		} else if(vx<0){
-			waves->createWave(sounds["footstep"], x, y+(dest.h-3));
-			setAnimation(animations["walkLeft"]);
+			waves->createWave(footstep, x, y+(dest.h-3));
+			setAnimation(animations[NAME_WALK_LEFT]);
 		} else{
-			waves->createWave(sounds["footstep"], x, y+(dest.h-3));
-			setAnimation(animations[(*cfg)["defaultAnimation"]]);
+			waves->createWave(footstep, x, y+(dest.h-3));
+			setAnimation(defaultAnimation);
 		}
 	}
 
 	void clap(){
 		if (!clapped){
-			waves->createWave(sounds["clap"], x+dest.w/2, y+dest.h/2);
+			waves->createWave(clapWave, x+dest.w/2, y+dest.h/2);
 			setClap(true);
 		}
 	}
@@ -186,120 +213,82 @@ class Character:public Particle{
 		onTile = false;
 
 		if (vx<0)
-			setAnimation(animations["jumpLeft"]);
+			setAnimation(animations[NAME_JUMP_LEFT]);
 		else
-			setAnimation(animations["jumpRight"]);
+			setAnimation(animations[NAME_JUMP_RIGHT]);
 	}
 
-	void collisions(vector<Tile *> tiles){
-		SDL_Rect topBox, bottomBox, leftBox, rightBox;
-		topBox.y = dest.y;
-		topBox.x = dest.x+5;
-		topBox.h = 5;
-		topBox.w = dest.w-10;
-		bottomBox.x = dest.x+5;
-		bottomBox.y = dest.y+dest.h-7;
-		bottomBox.h = 10;
-		bottomBox.w = dest.w-10;
-		leftBox.x = dest.x-2;
-		leftBox.y = dest.y+4;
-		leftBox.w = 8;
-		leftBox.h = dest.h-8;
-		rightBox.x = dest.x+dest.w-6;
-		rightBox.y = dest.y+4;
-		rightBox.w = 8;
-		rightBox.h = dest.h-8;
-
-		for(auto &t:tiles){
-			if(t->collide(&topBox) && vy < 0){
-				if(!(t->getType()=="door")){
-					setVy(0);
-				}
-				else if(!hasLeft && hasKey){
-					Mix_PlayChannel(-1,sounds["door"],0);
-					unlocked = true;
-				}
-			}
+	//Moves the character by the velocity update() integrated, sweeping its box through the grid so a
+	//large dt cannot tunnel through a tile. Cost depends on the distance moved, not the level size
+	void collisions(TileGrid &grid){
+		PROFILE_SCOPE("Character::collisions");
+		ALLOC_SCOPE(ALLOC_PLAYER);
 
-			else if(t->collide(&leftBox) && vx < 0){
-				if(!(t->getType()=="door")){
-					x = t->getX()+t->getW()+1;
-					vx = 0;
-				}
-				else if(!hasLeft && hasKey){
-					Mix_PlayChannel(-1,sounds["door"],0);
-					unlocked = true;
-				}
-			}
-			else if(t->collide(&rightBox) && vx > 0){
-				if(!(t->getType()=="door")){
-					x = t->getX()-dest.w-1;
-					vx = 0;
-				}
-				else if(!hasLeft && hasKey){
-					Mix_PlayChannel(-1,sounds["door"],0);
-					unlocked = true;
-				}
-			}
-			else if(t->collide(&bottomBox)){
-				if(!(t->getType()=="door")){
-					if(vy>0) waves->createWave(sounds["footstep"], x, y+(dest.h-3));
-					y = t->getY()-dest.h;
-					onTile = true;
-					break;
-				}
-				else if(!hasLeft && hasKey){
-					Mix_PlayChannel(-1,sounds["door"],0);
-					unlocked = true;
-				}
-			}
-			onTile = false;
+		TileContacts contacts = grid.move(x, y, dest.w, dest.h, vx, vy, moveDt, onTile);
+		moveDt = 0;
+
+		Profiler::get().count(COUNTER_COLLISION_TESTS, contacts.hitCount+1);
+
+		if(contacts.landed) waves->createWave(footstep, contacts.landX, contacts.landY);
+
+		if(contacts.touchedDoor && !hasLeft && hasKey){
+			media->playSound(sounds[NAME_DOOR]);
+			unlocked = true;
 		}
+
+		onTile = contacts.onTile;
 		if (!onTile){
 			ay = GRAVITY;
-			inAir = true;
 		}
-		else if (onTile){
+		else {
 			ay = 0;
 			vy = 0;
-			inAir = false;
 		}
+		inAir = !onTile;
+
+		dest.x = x;
+		dest.y = y;
 	}
 	
 
 	virtual void update(double dt){
-		Particle::update(dt);
+		ALLOC_SCOPE(ALLOC_PLAYER);
+
+		clampToBound();
+		vx += ax*dt;
+		vy += ay*dt;
+		moveDt = dt;
 
 		if(dir==LEFT && isOnTile()){
-			setAnimation(animations["walkLeft"]);
-			if(timeMoving >= 1000){
-				timeMoving %= 500;
-				waves->createWave(sounds["footstep"], x, y+dest.h);
+			setAnimation(animations[NAME_WALK_LEFT]);
+			if(timeMoving >= 1.0){
+				timeMoving = fmod(timeMoving, 0.5);
+				waves->createWave(footstep, x, y+dest.h);
 			}
 		}else if(dir==RIGHT && isOnTile()){
-			setAnimation(animations["walkRight"]);
-			if(timeMoving >= 1000){
-				timeMoving %= 500;
-				waves->createWave(sounds["footstep"], x+dest.w/2, y+(dest.h-3));
+			setAnimation(animations[NAME_WALK_RIGHT]);
+			if(timeMoving >= 1.0){
+				timeMoving = fmod(timeMoving, 0.5);
+				waves->createWave(footstep, x+dest.w/2, y+(dest.h-3));
 			}
 		}else if(isOnTile()){
-			setAnimation(animations[(*cfg)["defaultAnimation"]]);
+			setAnimation(defaultAnimation);
 		}
 
 
-		if(vx!=0) timeMoving += (int)(dt*1000.0);
+		if(vx!=0) timeMoving += dt;
 		
 		a->update(dt);
 		dest.x = x;
 		dest.y = y;
 	}
 
-	virtual void render(){
-		SDL_RenderCopy(ren, a->getTexture(), a->getFrame(), &dest);
+	virtual void render(DrawList &frame, Camera *camera=NULL){
+		SDL_Rect screen = camera ? camera->toScreen(&dest) : dest;
+		frame.sprite(a->getTexture(), a->getFrame(), screen, a->getTransparency());
 	}
 
 	~Character(){
-		for(auto a:animations) delete a.second;
-		for(auto s:sounds) delete s.second;
+		for(auto a:animations.all()) delete a;
 	}
 };
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+
+//Chunks are CHUNK_TILES x CHUNK_TILES tiles
+#define CHUNK_TILES 32
+#define CHUNK_CELLS (CHUNK_TILES*CHUNK_TILES)
+
+using namespace std;
+
+//A value per grid cell, stored a chunk at a time so only chunks in memory cost anything, the rest of the
+//level is an empty block each. Cells of chunks not in memory read as the fallback value. Cells are looked up
+//by column and row, or by key, their number chunk by chunk, which finds them again without dividing by the width
+template<typename T>
+class ChunkCells{
+	vector<vector<T> > blocks; //by chunk, row by row, empty when the chunk is not in memory
+	int cols, rows, chunksX;
+	T fallback;
+
+	//Cells are never negative, unsigned lets the divisions be shifts
+	int blockOf(unsigned c, unsigned r) const{ return (r/CHUNK_TILES)*chunksX + c/CHUNK_TILES; }
+	static int slotOf(unsigned c, unsigned r){ return (r%CHUNK_TILES)*CHUNK_TILES + c%CHUNK_TILES; }
+
+	vector<T> &block(unsigned key){
+		vector<T> &b = blocks[key/CHUNK_CELLS];
+		if(b.empty()) b.assign(CHUNK_CELLS, fallback);
+		return b;
+	}
+
+	public:
+	ChunkCells(T newFallback=T()){
+		fallback = newFallback;
+		cols = 0;
+		rows = 0;
+		chunksX = 0;
+	}
+
+	//Every chunk starts out of memory
+	void resize(int newCols, int newRows){
+		cols = newCols;
+		rows = newRows;
+		chunksX = (cols+CHUNK_TILES-1)/CHUNK_TILES;
+
+		blocks.clear();
+		blocks.shrink_to_fit();
+		blocks.resize(chunksX*((rows+CHUNK_TILES-1)/CHUNK_TILES));
+	}
+
+	//Cells must be inside the grid from here on
+	int key(int c, int r) const{ return blockOf(c, r)*CHUNK_CELLS + slotOf(c, r); }
+	int colOf(unsigned key) const{ return key/CHUNK_CELLS%chunksX*CHUNK_TILES + key%CHUNK_TILES; }
+	int rowOf(unsigned key) const{ return key/CHUNK_CELLS/chunksX*CHUNK_TILES + key%CHUNK_CELLS/CHUNK_TILES; }
+
+	bool has(unsigned key) const{ return !blocks[key/CHUNK_CELLS].empty(); }
+	bool has(int c, int r) const{ return has(key(c, r)); }
+
+	T get(unsigned key) const{
+		const vector<T> &b = blocks[key/CHUNK_CELLS];
+		return b.empty() ? fallback : b[key%CHUNK_CELLS];
+	}
+
+	T get(int c, int r) const{ return get(key(c, r)); }
+
+	//Brings the cell's chunk into memory if it is not already
+	T &at(unsigned key){ return block(key)[key%CHUNK_CELLS]; }
+	T &at(int c, int r){ return at(key(c, r)); }
+
+	//The chunk holding cell (c, r)
+	void load(int c, int r){ block(key(c, r)); }
+
+	void unload(int c, int r){
+		vector<T>().swap(blocks[blockOf(c, r)]);
+	}
+
+	size_t bytes() const{
+		size_t n = blocks.capacity()*sizeof(vector<T>);
+		for(auto &b:blocks) n += b.capacity()*sizeof(T);
+		return n;
+	}
+};
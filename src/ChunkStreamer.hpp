@@ -0,0 +1,211 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <SDL.h>
+#include <SDL_mutex.h>
+
+#include "Tile.hpp"
+#include "EntityStore.hpp"
+#include "Profiler.hpp"
+#include "AllocTracker.hpp"
+#include "ChunkCells.hpp"
+
+using namespace std;
+
+//Level text for one chunk, a row of characters per tile row, as read from disk
+struct ChunkData{
+	int index;
+	vector<string> rows;
+};
+
+//An entity saved when the chunk it stood in left memory, recreated when the chunk comes back
+struct EntityRecord{
+	EntityArchetype *type;
+	double x, y; //left edge and feet
+};
+
+enum ChunkState{CHUNK_UNLOADED, CHUNK_REQUESTED, CHUNK_RESIDENT};
+
+struct LevelChunk{
+	ChunkState state;
+	bool visited; //its NPCs and keys have been spawned from the level file once already
+	long lastUsed;
+	bool pinned; //around the checkpoint, never evicted so a restore reads nothing from disk
+
+	vector<Tile *> tiles;
+	vector<EntityRecord> npcs, keys;
+
+	LevelChunk(){
+		state = CHUNK_UNLOADED;
+		visited = false;
+		lastUsed = 0;
+		pinned = false;
+	}
+};
+
+//Indexes a level file once, then reads chunks of it on a background thread so the physics thread never waits
+//on the disk. Only the offset of each row is kept in memory, never the level itself
+class ChunkStreamer{
+	string filename;
+	vector<streamoff> rowOffsets;
+	vector<int> rowLengths;
+	int cols, rows;
+	int startCol, startRow;
+
+	SDL_Thread *thread;
+	SDL_mutex *mutex;
+	SDL_cond *wake;
+	deque<int> requests;
+	deque<ChunkData> loaded;
+	bool stopping;
+
+	ChunkData read(ifstream &in, int index){
+		ChunkData data;
+		data.index = index;
+
+		int c0 = (index%chunksX())*CHUNK_TILES, r0 = (index/chunksX())*CHUNK_TILES;
+
+		for(int r=r0; r<min(rows, r0+CHUNK_TILES); r++){
+			string row(min(CHUNK_TILES, max(0, rowLengths[r]-c0)), '0');
+
+			if(row.size() > 0){
+				in.clear();
+				in.seekg(rowOffsets[r]+c0);
+				in.read(&row[0], row.size());
+			}
+
+			data.rows.push_back(row);
+		}
+
+		return data;
+	}
+
+	static int loaderLoop(void *ptr){
+		ChunkStreamer *s = (ChunkStreamer *)ptr;
+		Profiler::get().nameThread("ChunkLoader");
+
+		ifstream in(s->filename, ios::binary);
+
+		SDL_LockMutex(s->mutex);
+		while(!s->stopping){
+			if(s->requests.empty()){
+				SDL_CondWait(s->wake, s->mutex);
+				continue;
+			}
+
+			int index = s->requests.front();
+			s->requests.pop_front();
+			SDL_UnlockMutex(s->mutex);
+
+			ChunkData data;
+			{
+				PROFILE_SCOPE("ChunkStreamer::read");
+				ALLOC_SCOPE(ALLOC_LEVEL);
+				data = s->read(in, index);
+			}
+
+			SDL_LockMutex(s->mutex);
+			s->loaded.push_back(data);
+		}
+		SDL_UnlockMutex(s->mutex);
+
+		return 0;
+	}
+
+	public:
+	ChunkStreamer(string newFilename){
+		filename = newFilename;
+		cols = 0;
+		rows = 0;
+		startCol = 0;
+		startRow = 0;
+		thread = NULL;
+		stopping = false;
+
+		mutex = SDL_CreateMutex();
+		wake = SDL_CreateCond();
+
+		ifstream in(filename, ios::binary);
+		if(!in) throw Exception("Could not open level " + filename);
+
+		string line;
+		for(streamoff offset = in.tellg(); getline(in, line); offset = in.tellg()){
+			if(!line.empty() && line.back()=='\r') line.pop_back();
+
+			size_t p = line.find('p');
+			if(p != string::npos){
+				startCol = p;
+				startRow = rowOffsets.size();
+			}
+
+			rowOffsets.push_back(offset);
+			rowLengths.push_back(line.size());
+
+			if(!line.empty()){
+				cols = max(cols, (int)line.size());
+				rows = rowOffsets.size();
+			}
+		}
+	}
+
+	int getCols(){ return cols; }
+	int getRows(){ return rows; }
+	int getStartCol(){ return startCol; }
+	int getStartRow(){ return startRow; }
+
+	int chunksX(){ return (cols+CHUNK_TILES-1)/CHUNK_TILES; }
+	int chunksY(){ return (rows+CHUNK_TILES-1)/CHUNK_TILES; }
+
+	//Starts the loader thread. Without it every chunk is read on demand by load()
+	void start(){
+		if(thread == NULL) thread = SDL_CreateThread(ChunkStreamer::loaderLoop, "ChunkLoader", (void *)this);
+	}
+
+	bool isStarted(){ return thread != NULL; }
+
+	void request(int index){
+		SDL_LockMutex(mutex);
+		requests.push_back(index);
+		SDL_CondSignal(wake);
+		SDL_UnlockMutex(mutex);
+	}
+
+	//Reads a chunk on the calling thread
+	ChunkData load(int index){
+		ifstream in(filename, ios::binary);
+		return read(in, index);
+	}
+
+	//Hands over one chunk the loader has finished, if any
+	bool poll(ChunkData &data){
+		bool found = false;
+
+		SDL_LockMutex(mutex);
+		if(!loaded.empty()){
+			data = loaded.front();
+			loaded.pop_front();
+			found = true;
+		}
+		SDL_UnlockMutex(mutex);
+
+		return found;
+	}
+
+	~ChunkStreamer(){
+		if(thread){
+			SDL_LockMutex(mutex);
+			stopping = true;
+			SDL_CondSignal(wake);
+			SDL_UnlockMutex(mutex);
+
+			int retVal;
+			SDL_WaitThread(thread, &retVal);
+		}
+
+		SDL_DestroyCond(wake);
+		SDL_DestroyMutex(mutex);
+	}
+};
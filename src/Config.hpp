@@ -4,6 +4,9 @@
 #include <string>
 #include <sstream>
 #include <map>
+#include <functional>
+
+#include "AllocTracker.hpp"
 
 using namespace std;
 
@@ -20,34 +23,66 @@ class Config{
 	}
 
 	void read(string filename){
+		ALLOC_SCOPE(ALLOC_CONFIG);
+
 		reader.open("config/"+filename+".conf");
 
+		for(string line; getline(reader, line);){
+            parseLine(line);
+		}
+
+		reader.close();
+		reader.clear();
+	}
+
+	//Reads the file again from scratch, dropping keys it no longer has and any set since, then hands the new keys to
+	//apply. If apply throws the old keys are put back and applied again, so a half-saved file breaks nothing
+	void reload(function<void()> apply=[]{}){
+		ALLOC_SCOPE(ALLOC_CONFIG);
+
+		map<string, string> old = cfg;
+		cfg.clear();
+		read(name);
+
+		try{
+			apply();
+		} catch(...){
+			cfg = old;
+			apply();
+			throw;
+		}
+	}
+
+	string getName(){ return name; }
+
+	//Lines are key=value, the same form is accepted from the command line to override the file
+	void parseLine(string line){
 		string key = "";
         string value = "";
         bool isKey = true;
 
-		for(string line; getline(reader, line);){
-            for(char c: line){
-                if(c == '='){
-                    isKey = false;
-                    continue;
-                }
-                
-                if(isKey)
-                    key = key + c;
-                else
-                    value = value + c;
+        for(char c: line){
+            if(c == '=' && isKey){
+                isKey = false;
+                continue;
             }
-            cfg[key] = value;
-            key = "";
-            value = "";
-            isKey = true;
-		}
+            
+            if(isKey)
+                key = key + c;
+            else
+                value = value + c;
+        }
+        cfg[key] = value;
 	}
 
-	string operator [](string key){
-        if(cfg.find(key) != cfg.end())
-            return cfg[key];
+	bool has(string key){ return cfg.find(key) != cfg.end(); }
+	void set(string key, string value){ cfg[key] = value; }
+
+	//Returns the stored value rather than a copy, so reading a key every tick allocates nothing
+	const string &operator [](const string &key){
+        auto found = cfg.find(key);
+        if(found != cfg.end())
+            return found->second;
         else
             throw Exception("Key: " + key + " not found in config object " + name);
     }
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <SDL.h>
+
+#include "Profiler.hpp"
+
+using namespace std;
+
+//One sprite copy. Textures belong to the MediaManager and live as long as the game, so they serve as sprite ids
+struct SpriteDraw{
+	SDL_Texture *texture;
+	SDL_Rect src, dst;
+	Uint8 alpha;
+};
+
+//One wave's particles, the rects from first to first+count in the list's particle array
+struct ParticleBatch{
+	Uint8 color;
+	int first, count;
+};
+
+//A sprite or a particle batch, by its index in the list's array of either
+struct DrawCommand{
+	bool wave;
+	int index;
+};
+
+//Everything one frame shows, in screen pixels and back to front. Built by the physics thread at the end of a tick
+//and only read once published, so the render thread never touches a simulation object
+class DrawList{
+	vector<ParticleBatch> batches;
+	vector<SDL_Rect> particles;
+	vector<SpriteDraw> sprites;
+	vector<DrawCommand> order; //batches and sprites as they were added, which is the order they are drawn in
+
+	public:
+	int tick; //the physics tick this shows
+
+	void clear(){
+		batches.clear();
+		particles.clear();
+		sprites.clear();
+		order.clear();
+		tick = 0;
+	}
+
+	void beginWave(double color){
+		ParticleBatch b = {(Uint8)max(0.0, min(255.0, color)), (int)particles.size(), 0};
+		order.push_back({true, (int)batches.size()});
+		batches.push_back(b);
+	}
+
+	void particle(int x, int y, int size){
+		SDL_Rect r = {x, y, size, size};
+		particles.push_back(r);
+		batches.back().count++;
+	}
+
+	void sprite(SDL_Texture *texture, SDL_Rect *src, SDL_Rect dst, int alpha=255){
+		SpriteDraw s = {texture, *src, dst, (Uint8)max(0, min(255, alpha))};
+		order.push_back({false, (int)sprites.size()});
+		sprites.push_back(s);
+	}
+
+	//Render thread only
+	void draw(SDL_Renderer *ren){
+		PROFILE_SCOPE("DrawList::draw");
+
+		for(auto &c:order){
+			if(c.wave){
+				ParticleBatch &b = batches[c.index];
+				if(b.count == 0) continue;
+
+				SDL_SetRenderDrawColor(ren, b.color, b.color, b.color, 255);
+				SDL_RenderFillRects(ren, &particles[b.first], b.count);
+			} else {
+				SpriteDraw &s = sprites[c.index];
+				SDL_SetTextureAlphaMod(s.texture, s.alpha);
+				SDL_RenderCopy(ren, s.texture, &s.src, &s.dst);
+			}
+		}
+		SDL_SetRenderDrawColor(ren, 0x00, 0x00, 0x00, 0xFF);
+
+		Profiler::get().count(COUNTER_DRAW_CALLS, batches.size()+sprites.size());
+	}
+};
+
+//Three draw lists passed from the physics thread to the render thread without a lock. The physics thread always
+//has one to fill, the render thread always has one to read, and the third holds the newest finished frame.
+//Publishing and acquiring each swap a list with that third slot, so neither thread ever waits for the other
+class DrawBuffer{
+	DrawList lists[3];
+	int writing, reading;
+	atomic<int> ready; //index of the newest finished list, with FRESH set until the render thread takes it
+
+	static const int FRESH = 4;
+
+	public:
+	DrawBuffer(){
+		writing = 0;
+		ready = 1;
+		reading = 2;
+
+		for(int i=0; i<3; i++) lists[i].clear();
+	}
+
+	//Physics thread: the list to build this tick's frame into, emptied
+	DrawList &back(){
+		lists[writing].clear();
+		return lists[writing];
+	}
+
+	void publish(){
+		writing = ready.exchange(writing | FRESH, memory_order_acq_rel) & 3;
+	}
+
+	//Render thread: the newest published frame, or NULL when nothing new has arrived since the last call
+	DrawList *acquire(){
+		if(!(ready.load(memory_order_acquire) & FRESH)) return NULL;
+
+		reading = ready.exchange(reading, memory_order_acq_rel) & 3;
+		return &lists[reading];
+	}
+};
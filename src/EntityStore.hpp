@@ -0,0 +1,395 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <SDL_mixer.h>
+#include <SDL.h>
+
+#include "Animation.hpp"
+#include "MediaManager.hpp"
+#include "Config.hpp"
+#include "Wave.hpp"
+#include "Tile.hpp"
+#include "TileGrid.hpp"
+#include "FlowField.hpp"
+#include "Character.hpp"
+#include "Profiler.hpp"
+#include "AllocTracker.hpp"
+#include "Camera.hpp"
+#include "DrawList.hpp"
+#include "Names.hpp"
+
+#define DEAD_SLOT 0xFFFFFFFFu
+
+using namespace std;
+
+//Everything entities built from the same config share: animations, sounds, size and speeds.
+//Loaded once per config instead of once per entity
+class EntityArchetype{
+	NameTable<Animation *> animations;
+	NameTable<Mix_Chunk *> sounds;
+
+	public:
+	Config *cfg;
+	int w, h;
+	double baseSpeed, jumpSpeed;
+
+	Animation *defaultAnimation, *walkLeft, *walkRight;
+	WaveProfile *footstep, *clap;
+
+	FlowField *flow; //routes to the player for this body, owned by the level
+
+	EntityArchetype(MediaManager *media, Waves *waves, Config *newCfg){
+		cfg = newCfg;
+		flow = NULL;
+		configure();
+
+		for(auto anim: cfg->getMany("animations")){
+			Animation *a = new Animation();
+			a->readAnimation(media, anim);
+			animations.set(Names::get().id(anim), a);
+		}
+
+		for(auto sound: cfg->getMany("sounds")){
+			sounds.set(Names::get().id(sound), media->readSound(sound));
+		}
+
+		defaultAnimation = animations[Names::get().id((*cfg)["defaultAnimation"])];
+		walkLeft = getAnimation(NAME_WALK_LEFT);
+		walkRight = getAnimation(NAME_WALK_RIGHT);
+
+		footstep = waves->profile("footstep");
+		clap = waves->profile("clap");
+	}
+
+	//Size and speeds from the config, read again when it is reloaded. Entities already made keep their size
+	void configure(){
+		w = stoi((*cfg)["width"]) * stoi((*cfg)["scale"]);
+		h = stoi((*cfg)["height"]) * stoi((*cfg)["scale"]);
+
+		baseSpeed = stod((*cfg)["baseSpeed"]);
+		jumpSpeed = stod((*cfg)["jumpSpeed"]);
+	}
+
+	//Missing animations fall back to the default so entities without a walk cycle still draw
+	Animation *getAnimation(int name){
+		return animations.has(name) ? animations[name] : defaultAnimation;
+	}
+
+	Mix_Chunk *getSound(int name){ return sounds[name]; }
+
+	~EntityArchetype(){
+		for(auto a:animations.all()) delete a;
+	}
+};
+
+//Refers to an entity across removals. A handle goes stale once its entity is removed, even if the slot is reused
+struct EntityHandle{
+	unsigned index;
+	unsigned generation;
+};
+
+//Entities stored as parallel arrays so each per-tick pass walks contiguous memory.
+//Removal swaps the last entity into the hole, so order is not stable but no element ever shifts
+class EntityStore{
+	//Dense, one element per live entity
+	vector<double> x, y, vx, vy, ay;
+	vector<int> w, h;
+	vector<direction> dir;
+	vector<char> onTile;
+	vector<double> timeMoving; //s walked since the last footstep
+	vector<Animation *> anim;
+	vector<int> animTime;
+	vector<EntityArchetype *> archetype;
+	vector<unsigned> owner; //slot of each dense element
+	vector<double> stepDt; //time each entity advances this update, 0 while throttled
+	vector<double> skipped; //time a throttled entity has yet to catch up on
+
+	//Sparse, one element per handle slot ever issued
+	vector<unsigned> slotDense;
+	vector<unsigned> slotGeneration;
+	vector<unsigned> freeSlots;
+
+	Waves *waves;
+	bool chasesPlayer, collidesWithTiles;
+	int minx, miny, maxx, maxy;
+
+	//Entities further than throttleRadius from the player only update every throttleInterval updates
+	int throttleRadius, throttleInterval;
+	long updates;
+
+	template<typename T>
+	static void swapRemove(vector<T> &v, int i){
+		v[i] = v.back();
+		v.pop_back();
+	}
+
+	public:
+	EntityStore(Waves *newWaves, bool newChasesPlayer, bool newCollidesWithTiles){
+		waves = newWaves;
+		chasesPlayer = newChasesPlayer;
+		collidesWithTiles = newCollidesWithTiles;
+		throttleRadius = 0;
+		throttleInterval = 1;
+		updates = 0;
+		setBound();
+	}
+
+	//Same world box as Particle::setBound, no clamping without one
+	void setBound(int newMinX=0, int newMinY=0, int newMaxX=0, int newMaxY=0){
+		minx = newMinX;
+		miny = newMinY;
+		maxx = newMaxX;
+		maxy = newMaxY;
+	}
+
+	//A radius of 0 updates every entity every time
+	void setThrottle(int newRadius, int newInterval){
+		throttleRadius = newRadius;
+		throttleInterval = max(1, newInterval);
+	}
+
+	int size(){ return x.size(); }
+
+	//The entity's feet are placed at (newX, newY), like a Character
+	EntityHandle create(EntityArchetype *type, double newX, double newY){
+		unsigned slot;
+		if(freeSlots.empty()){
+			slot = slotDense.size();
+			slotDense.push_back(DEAD_SLOT);
+			slotGeneration.push_back(0);
+		} else {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+
+		slotDense[slot] = x.size();
+
+		x.push_back(newX);
+		y.push_back(newY-type->h);
+		vx.push_back(0);
+		vy.push_back(0);
+		ay.push_back(0);
+		w.push_back(type->w);
+		h.push_back(type->h);
+		dir.push_back(STOP);
+		onTile.push_back(true);
+		timeMoving.push_back(0);
+		anim.push_back(type->defaultAnimation);
+		animTime.push_back(0);
+		archetype.push_back(type);
+		owner.push_back(slot);
+		stepDt.push_back(0);
+		skipped.push_back(0);
+
+		return {slot, slotGeneration[slot]};
+	}
+
+	bool valid(EntityHandle handle){
+		return handle.index < slotDense.size() && slotGeneration[handle.index] == handle.generation
+			&& slotDense[handle.index] != DEAD_SLOT;
+	}
+
+	EntityHandle handleAt(int i){ return {owner[i], slotGeneration[owner[i]]}; }
+
+	void remove(EntityHandle handle){
+		if(valid(handle)) removeAt(slotDense[handle.index]);
+	}
+
+	void removeAt(int i){
+		unsigned slot = owner[i];
+		unsigned moved = owner.back();
+
+		swapRemove(x, i); swapRemove(y, i);
+		swapRemove(vx, i); swapRemove(vy, i); swapRemove(ay, i);
+		swapRemove(w, i); swapRemove(h, i);
+		swapRemove(dir, i); swapRemove(onTile, i); swapRemove(timeMoving, i);
+		swapRemove(anim, i); swapRemove(animTime, i);
+		swapRemove(archetype, i); swapRemove(owner, i);
+		swapRemove(stepDt, i); swapRemove(skipped, i);
+
+		if(moved != slot) slotDense[moved] = i;
+
+		slotDense[slot] = DEAD_SLOT;
+		slotGeneration[slot]++;
+		freeSlots.push_back(slot);
+	}
+
+	void clear(){
+		while(size() > 0) removeAt(size()-1);
+	}
+
+	EntityArchetype *getArchetype(int i){ return archetype[i]; }
+	double getX(int i){ return x[i]; }
+	double getY(int i){ return y[i]; }
+
+	SDL_Rect getDest(int i){
+		SDL_Rect dest = {(int)x[i], (int)y[i], w[i], h[i]};
+		return dest;
+	}
+
+	//Steers every entity along its archetype's flow field, or straight toward playerX without one,
+	//starting a walk cycle and a footstep when the direction changes. Entities in the air keep their heading
+	void think(double playerX){
+		if(!chasesPlayer) return;
+
+		for(int i=0; i<size(); i++){
+			if(stepDt[i]==0 || !onTile[i]) continue;
+
+			FlowStep next = {STOP, false};
+			FlowField *flow = archetype[i]->flow;
+
+			if(flow) next = flow->step(x[i], y[i], w[i], h[i]);
+			else if(x[i] <= playerX-1) next.dir = RIGHT;
+			else if(x[i] >= playerX+1) next.dir = LEFT;
+
+			if(next.jump){
+				vy[i] = archetype[i]->jumpSpeed;
+				onTile[i] = false;
+			}
+
+			direction want = next.dir;
+			if(want == dir[i]) continue;
+			dir[i] = want;
+
+			if(want == STOP){
+				vx[i] = 0;
+				timeMoving[i] = 0;
+				anim[i] = archetype[i]->defaultAnimation;
+			} else if(want == RIGHT){
+				vx[i] = archetype[i]->baseSpeed;
+				if(onTile[i]) waves->createWave(archetype[i]->footstep, x[i]+w[i]/2, y[i]+h[i]);
+				anim[i] = archetype[i]->walkRight;
+			} else {
+				vx[i] = -archetype[i]->baseSpeed;
+				if(onTile[i]) waves->createWave(archetype[i]->footstep, x[i]+w[i]/4, y[i]+h[i]);
+				anim[i] = archetype[i]->walkLeft;
+			}
+		}
+	}
+
+	//Clamps to the world box then integrates velocity. Entities that collide are moved by collide(),
+	//the rest move here
+	void integrate(){
+		for(int i=0; i<size(); i++){
+			if(maxx != minx){
+				if(x[i] < minx) x[i] = minx;
+				if(x[i] > maxx) x[i] = maxx;
+				if(y[i] < miny) y[i] = miny;
+				if(y[i] > maxy) y[i] = maxy;
+			}
+
+			vy[i] += ay[i]*stepDt[i];
+		}
+
+		if(collidesWithTiles) return;
+
+		for(int i=0; i<size(); i++){
+			x[i] += vx[i]*stepDt[i];
+			y[i] += vy[i]*stepDt[i];
+		}
+	}
+
+	//Picks each entity's animation, spaces walking footsteps and advances animation time
+	void animate(){
+		for(int i=0; i<size(); i++){
+			if(stepDt[i]==0) continue;
+
+			double dt = stepDt[i];
+			EntityArchetype *type = archetype[i];
+
+			if(dir[i]==LEFT && onTile[i]){
+				anim[i] = type->walkLeft;
+				if(timeMoving[i] >= 1.0){
+					timeMoving[i] = fmod(timeMoving[i], 0.5);
+					waves->createWave(type->footstep, x[i], y[i]+h[i]);
+				}
+			} else if(dir[i]==RIGHT && onTile[i]){
+				anim[i] = type->walkRight;
+				if(timeMoving[i] >= 1.0){
+					timeMoving[i] = fmod(timeMoving[i], 0.5);
+					waves->createWave(type->footstep, x[i]+w[i]/2, y[i]+(h[i]-3));
+				}
+			} else if(onTile[i]){
+				anim[i] = type->defaultAnimation;
+			}
+
+			if(vx[i]!=0) timeMoving[i] += dt;
+
+			animTime[i] = anim[i]->advance(animTime[i], dt);
+		}
+	}
+
+	//Sweeps every entity through the grid by its velocity over dt, the same way Character moves
+	void collide(TileGrid &grid){
+		if(!collidesWithTiles) return;
+
+		PROFILE_SCOPE("EntityStore::collide");
+		ALLOC_SCOPE(ALLOC_ENTITIES);
+		Profiler::get().count(COUNTER_COLLISION_TESTS, size());
+
+		for(int i=0; i<size(); i++){
+			if(stepDt[i]==0) continue;
+
+			TileContacts contacts = grid.move(x[i], y[i], w[i], h[i], vx[i], vy[i], stepDt[i], onTile[i]);
+
+			if(contacts.landed) waves->createWave(archetype[i]->footstep, contacts.landX, contacts.landY);
+
+			onTile[i] = contacts.onTile;
+			if(onTile[i]){
+				ay[i] = 0;
+				vy[i] = 0;
+			} else ay[i] = GRAVITY;
+		}
+	}
+
+	//Decides how far each entity advances: dt near the player, and the time saved up every
+	//throttleInterval updates for those further away. Entities are staggered so the catch up is spread out
+	void schedule(double dt, double playerX, double playerY){
+		updates++;
+
+		for(int i=0; i<size(); i++){
+			bool far = throttleRadius > 0 && (fabs(x[i]-playerX) > throttleRadius || fabs(y[i]-playerY) > throttleRadius);
+
+			skipped[i] += dt;
+			if(far && (updates+i)%throttleInterval != 0){
+				stepDt[i] = 0;
+			} else {
+				stepDt[i] = skipped[i];
+				skipped[i] = 0;
+			}
+		}
+	}
+
+	void update(double dt, double playerX, double playerY, TileGrid &grid){
+		schedule(dt, playerX, playerY);
+		think(playerX);
+		integrate();
+		animate();
+		collide(grid);
+	}
+
+	//Index of the first entity overlapping rect, or -1
+	int findTouching(SDL_Rect *rect, int start=0){
+		for(int i=start; i<size(); i++){
+			SDL_Rect dest = getDest(i);
+			if(SDL_HasIntersection(&dest, rect)) return i;
+		}
+
+		return -1;
+	}
+
+	//Draws the entities inside the camera's view
+	void render(DrawList &frame, Camera *camera=NULL){
+		for(int i=0; i<size(); i++){
+			SDL_Rect dest = getDest(i);
+
+			if(camera){
+				if(!camera->visible(&dest)) continue;
+				dest = camera->toScreen(&dest);
+			}
+
+			frame.sprite(anim[i]->getTexture(), anim[i]->getFrame(animTime[i]), dest, anim[i]->getTransparency());
+		}
+	}
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <SDL.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define WATCH_POLL_MS 500 //how often directories are rescanned where inotify is not available
+
+using namespace std;
+
+//Reports files written in a set of directories, as "dir/name". On Linux inotify says which files changed, so a poll
+//is one non-blocking read. Elsewhere each directory is rescanned every WATCH_POLL_MS for changed modification times
+class FileWatcher{
+	vector<string> dirs;
+	map<string, time_t> modified;
+	Uint32 lastScan;
+
+#ifdef __linux__
+	int fd;
+	map<int, string> watches;
+#endif
+
+	//Records every file's modification time, adding the names of any that changed since the last scan
+	void scan(string dir, vector<string> *changed){
+		DIR *d = opendir(dir.c_str());
+		if(d == NULL) return;
+
+		for(dirent *e = readdir(d); e != NULL; e = readdir(d)){
+			string path = dir + "/" + e->d_name;
+			struct stat info;
+			if(stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) continue;
+
+			auto known = modified.find(path);
+			if(changed && (known == modified.end() || known->second != info.st_mtime)) changed->push_back(path);
+			modified[path] = info.st_mtime;
+		}
+
+		closedir(d);
+	}
+
+	public:
+	FileWatcher(){
+		lastScan = 0;
+
+#ifdef __linux__
+		fd = inotify_init1(IN_NONBLOCK);
+#endif
+	}
+
+	void watch(string dir){
+		dirs.push_back(dir);
+
+#ifdef __linux__
+		//Editors that save by renaming a temporary file over the old one show up as IN_MOVED_TO
+		if(fd >= 0){
+			int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if(wd >= 0){
+				watches[wd] = dir;
+				return;
+			}
+		}
+#endif
+
+		scan(dir, NULL);
+	}
+
+	//Files written since the last poll, each named once however many times it was written
+	vector<string> poll(){
+		vector<string> changed;
+
+#ifdef __linux__
+		if(fd >= 0 && !watches.empty()){
+			char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+			for(ssize_t n = read(fd, buffer, sizeof(buffer)); n > 0; n = read(fd, buffer, sizeof(buffer))){
+				for(char *p = buffer; p < buffer+n; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len){
+					struct inotify_event *e = (struct inotify_event *)p;
+					if(e->len > 0 && watches.count(e->wd)) changed.push_back(watches[e->wd] + "/" + e->name);
+				}
+			}
+
+			sort(changed.begin(), changed.end());
+			changed.erase(unique(changed.begin(), changed.end()), changed.end());
+			return changed;
+		}
+#endif
+
+		if(SDL_GetTicks()-lastScan < WATCH_POLL_MS) return changed;
+		lastScan = SDL_GetTicks();
+
+		for(auto &dir:dirs) scan(dir, &changed);
+		return changed;
+	}
+
+	~FileWatcher(){
+#ifdef __linux__
+		if(fd >= 0) close(fd);
+#endif
+	}
+};
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <vector>
+#include <math.h>
+#include <SDL.h>
+
+#include "TileGrid.hpp"
+#include "Character.hpp"
+#include "Profiler.hpp"
+
+//Furthest a fall edge is searched for, in cells. Keeps a change to the tiles local to the cells around it
+#define FLOW_MAX_FALL 32
+
+using namespace std;
+
+//One move out of a standing cell: which way to walk and whether to jump first
+struct FlowStep{
+	direction dir;
+	bool jump;
+};
+
+//A standing cell's moves to the target and the first of them, only meant for the search whose generation it has
+struct FlowRoute{
+	unsigned generation;
+	int dist;
+	FlowStep step;
+};
+
+struct FlowEdge{
+	int from; //key of the cell the move starts in
+	FlowStep step;
+};
+
+//Shortest routes to one target over the cells a body can stand in, shared by every entity of that body.
+//Walk, fall and jump edges are found as tiles arrive, retargeting is one BFS when the target changes cell
+//and each entity reads its next move with a single lookup. Only the grid's loaded chunks can be stood in,
+//so everything per cell is kept for those chunks alone
+class FlowField{
+	TileGrid *grid;
+	int cols, rows;
+	int clearance; //cells of headroom the body needs
+	int maxRise; //cells a jump can climb
+	int maxReach; //cells a jump can cross on flat ground
+
+	ChunkCells<vector<FlowEdge> > incoming; //per cell, the moves that lead into it
+	ChunkCells<FlowRoute> routes;
+	unsigned generation; //of the latest search, so starting one never has to clear the last
+	vector<int> queue;
+
+	int target;
+	double targetX;
+
+	bool solid(int c, int r){
+		Tile *t = grid->at(c, r);
+		return t && t->isSolid();
+	}
+
+	//Above the level counts as open, below it and beside it do not
+	bool open(int c, int r){
+		if(c<0 || c>=cols || r>=rows) return false;
+		return r<0 || !solid(c, r);
+	}
+
+	bool bodyFits(int c, int r){
+		for(int i=0; i<clearance; i++) if(!open(c, r-i)) return false;
+		return true;
+	}
+
+	bool standable(int c, int r){
+		return grid->isLoaded(c, r) && bodyFits(c, r) && solid(c, r+1);
+	}
+
+	void addEdge(int fromC, int fromR, int toC, int toR, direction dir, bool jump){
+		FlowEdge e = {incoming.key(fromC, fromR), {dir, jump}};
+		incoming.at(toC, toR).push_back(e);
+	}
+
+	//Walking off the side, then falling until the body lands
+	void addWalk(int c, int r, int side, direction dir){
+		int nc = c+side;
+		if(!bodyFits(nc, r)) return;
+
+		for(int nr=r; nr<rows && nr<=r+FLOW_MAX_FALL && bodyFits(nc, nr); nr++){
+			if(standable(nc, nr)){
+				addEdge(c, r, nc, nr, dir, false);
+				return;
+			}
+		}
+	}
+
+	void addJumps(int c, int r, int side, direction dir){
+		//Up onto a ledge beside, with headroom over the take off cell
+		for(int k=1; k<=maxRise; k++){
+			if(!open(c, r-clearance+1-k)) break;
+			if(standable(c+side, r-k)){
+				addEdge(c, r, c+side, r-k, dir, true);
+				break;
+			}
+		}
+
+		//Across a gap to the same height
+		if(standable(c+side, r)) return;
+		for(int d=2; d<=maxReach; d++){
+			if(!bodyFits(c+side*(d-1), r)) break;
+			if(standable(c+side*d, r)){
+				addEdge(c, r, c+side*d, r, dir, true);
+				break;
+			}
+		}
+	}
+
+	public:
+	FlowField(TileGrid *newGrid, int height, double baseSpeed, double jumpSpeed):routes({0, -1, {STOP, false}}){
+		grid = newGrid;
+		cols = grid->getCols();
+		rows = grid->getRows();
+		int cell = grid->getCellSize();
+
+		clearance = max(1, (int)ceil((double)height/cell));
+
+		//Apex height v^2/2g and time in the air 2v/g of a jump from standstill
+		double v = fabs(jumpSpeed);
+		maxRise = (int)floor(v*v/(2*GRAVITY)/cell);
+		maxReach = (int)floor(fabs(baseSpeed)*2*v/GRAVITY/cell);
+
+		target = -1;
+		targetX = 0;
+		generation = 0;
+
+		build();
+	}
+
+	void build(){
+		incoming.resize(cols, rows);
+		routes.resize(cols, rows);
+
+		for(int r=0; r<rows; r+=CHUNK_TILES)
+			for(int c=0; c<cols; c+=CHUNK_TILES)
+				if(grid->isLoaded(c, r)) addEdges(c, r, min(cols, c+CHUNK_TILES)-1, min(rows, r+CHUNK_TILES)-1);
+	}
+
+	void addEdges(int c0, int r0, int c1, int r1){
+		for(int r=r0; r<=r1; r++){
+			for(int c=c0; c<=c1; c++){
+				if(!standable(c, r)) continue;
+
+				addWalk(c, r, -1, LEFT);
+				addWalk(c, r, 1, RIGHT);
+				addJumps(c, r, -1, LEFT);
+				addJumps(c, r, 1, RIGHT);
+			}
+		}
+	}
+
+	//Tiles in the cells c0..c1, r0..r1 were added or removed. Every cell whose moves could pass through them
+	//has its edges found again, and the next setTarget runs a fresh BFS
+	void tilesChanged(int c0, int r0, int c1, int r1){
+		PROFILE_SCOPE("FlowField::tilesChanged");
+
+		int reach = max(maxReach, 1)+1;
+
+		//Cells whose moves read the changed cells
+		int fc0 = max(0, c0-reach), fc1 = min(cols-1, c1+reach);
+		int fr0 = max(0, r0-FLOW_MAX_FALL-1), fr1 = min(rows-1, r1+clearance+maxRise+1);
+
+		//Cells those moves can land in
+		int tc0 = max(0, fc0-reach), tc1 = min(cols-1, fc1+reach);
+		int tr0 = max(0, fr0-maxRise-1), tr1 = min(rows-1, fr1+FLOW_MAX_FALL+1);
+
+		for(int r=tr0; r<=tr1; r++){
+			for(int c=tc0; c<=tc1; c++){
+				if(!incoming.has(c, r)) continue;
+				vector<FlowEdge> &in = incoming.at(c, r);
+
+				for(int i=in.size()-1; i>=0; i--){
+					int fc = incoming.colOf(in[i].from), fr = incoming.rowOf(in[i].from);
+					if(fc>=fc0 && fc<=fc1 && fr>=fr0 && fr<=fr1){
+						in[i] = in.back();
+						in.pop_back();
+					}
+				}
+			}
+		}
+
+		addEdges(fc0, fr0, fc1, fr1);
+		target = -1;
+	}
+
+	//The grid has unloaded the chunk holding cell (c, r). Call tilesChanged over it as well, for the moves
+	//into and out of it from the chunks around
+	void unloadChunk(int c, int r){
+		incoming.unload(c, r);
+		routes.unload(c, r);
+		target = -1;
+	}
+
+	//Key of the standing cell under a box, dropping through open cells when it is in the air, or -1
+	int cellUnder(double x, double y, double w, double h){
+		int c = grid->colOf(x+w/2);
+		for(int r=max(0, grid->rowOf(y+h-1)); r<rows; r++){
+			if(standable(c, r)) return incoming.key(c, r);
+			if(!open(c, r)) break;
+		}
+
+		return -1;
+	}
+
+	//Routes everything toward the box, recomputing only when it has moved to another standing cell
+	void setTarget(double x, double y, double w, double h){
+		targetX = x;
+
+		int cell = cellUnder(x, y, w, h);
+		if(cell < 0 || cell == target) return;
+
+		PROFILE_SCOPE("FlowField::setTarget");
+
+		target = cell;
+		generation++;
+
+		queue.clear();
+		queue.push_back(target);
+		routes.at(target) = {generation, 0, {STOP, false}};
+
+		for(size_t i=0; i<queue.size(); i++){
+			int v = queue[i];
+			if(!incoming.has(v)) continue;
+
+			int d = routes.get(v).dist+1;
+			for(auto &e:incoming.at(v)){
+				FlowRoute &route = routes.at(e.from);
+				if(route.generation == generation) continue;
+
+				route = {generation, d, e.step};
+				queue.push_back(e.from);
+			}
+		}
+	}
+
+	//Next move for a box at (x, y). Boxes in the target's cell, with no route, or in the air head straight for the target
+	FlowStep step(double x, double y, double w, double h){
+		int c = grid->colOf(x+w/2), r = grid->rowOf(y+h-1);
+
+		if(c>=0 && c<cols && r>=0 && r<rows){
+			FlowRoute route = routes.get(c, r);
+			if(incoming.key(c, r) != target && route.generation == generation && route.dist > 0) return route.step;
+		}
+
+		FlowStep straight = {STOP, false};
+		if(x <= targetX-1) straight.dir = RIGHT;
+		else if(x >= targetX+1) straight.dir = LEFT;
+
+		return straight;
+	}
+
+	int distance(double x, double y, double w, double h){
+		int cell = cellUnder(x, y, w, h);
+		if(cell < 0) return -1;
+
+		FlowRoute route = routes.get(cell);
+		return route.generation == generation ? route.dist : -1;
+	}
+};
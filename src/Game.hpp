@@ -1,5 +1,10 @@
 #pragma once
 
+//Input events that fit between two physics ticks
+#define INPUT_QUEUE_SIZE 256
+//Longest the main thread sleeps waiting for an event before it checks on the window title again
+#define INPUT_WAIT_MS 250
+
 using namespace std;
 
 class Game {
@@ -8,10 +13,59 @@ class Game {
 	SDL_Window *window;
 	SDL_Renderer *ren;
 	int ticks; //ms ticks since start
-	bool is_running;
+	atomic<bool> is_running;
+	bool headless; //no window, renderer or audio device
+
+	//Input is queued by the main thread and applied by the physics thread at the start of a tick,
+	//so a recorded session knows exactly which tick every key landed on
+	SpscQueue<SDL_Event, INPUT_QUEUE_SIZE> input;
+
+	//While paused the physics and render threads sleep on resumed instead of ticking.
+	//pause() waits on parkedCond until every running loop has parked
+	SDL_mutex *pauseMutex;
+	SDL_cond *resumed;
+	SDL_cond *parkedCond;
+	bool paused;
+	int loops; //physics and render loops still running
+	int parked; //loops asleep in waitWhilePaused
+
+	Replay replay;
+	int tickCount;
+
+	//Frames the physics thread builds at the end of each tick for the render thread to draw
+	DrawBuffer frames;
+
+	string traceFile; //Chrome trace written here when the game stops, empty for none
+
+	LatencyTracker latency;
+	string latencyReport; //latency summary written here when the game stops, empty for none
+	string memoryReport; //allocation reports appended here, empty for stdout
+	SoakTest soak;
+	string title;
 
     public:
-	Game(string title, int w=640, int h=480){
+	Game(string newTitle, int w=640, int h=480, bool newHeadless=false){
+		headless = newHeadless;
+		title = newTitle;
+		pauseMutex = SDL_CreateMutex();
+		resumed = SDL_CreateCond();
+		parkedCond = SDL_CreateCond();
+		paused = false;
+		loops = 0;
+		parked = 0;
+		tickCount = 0;
+
+		if(headless){
+			SDL_Init(SDL_INIT_TIMER);
+
+			window = NULL;
+			ren = NULL;
+			media = new MediaManager(NULL, true);
+
+			ticks = SDL_GetTicks();
+			return;
+		}
+
 		SDL_Init(SDL_INIT_VIDEO|SDL_INIT_AUDIO); 
 		window = SDL_CreateWindow(
 			title.c_str(),                     // window title
@@ -35,32 +89,173 @@ class Game {
 		ticks = SDL_GetTicks();
 	}
 
+	//One physics tick: apply queued (or replayed) input, then update. When replaying the recorded dt replaces the measured one
+	void tick(double dt){
+		AllocTracker::get().beginTick();
+
+		vector<SDL_Event> inputs;
+
+		if(replay.isPlaying()){
+			if(!replay.nextTick(inputs, dt)){
+				is_running = false;
+				return;
+			}
+		} else {
+			SDL_Event e;
+			while(input.pop(e)) inputs.push_back(e);
+		}
+
+		for(auto &e:inputs){
+			replay.recordInput(e);
+			latency.consumed(e, tickCount+1);
+
+			if (e.type==SDL_KEYDOWN) handleKeyDown(e);
+			else if (e.type==SDL_KEYUP) handleKeyUp(e);
+		}
+
+		replay.recordTick(dt);
+
+		Uint64 start = SDL_GetPerformanceCounter();
+		update(dt);
+		Uint64 updated = SDL_GetPerformanceCounter();
+
+		tickCount++;
+		replay.checkpoint(tickCount, stateHash());
+
+		//A soak test builds frames headless too, drawing the waves is part of what it measures
+		if(!headless || soak.isEnabled()){
+			PROFILE_SCOPE("Game::buildFrame");
+			ALLOC_SCOPE(ALLOC_FRAME);
+
+			updated = SDL_GetPerformanceCounter();
+
+			DrawList &frame = frames.back();
+			frame.tick = tickCount;
+			buildFrame(frame);
+			frames.publish();
+		}
+
+		if(soak.isEnabled()){
+			Uint64 built = SDL_GetPerformanceCounter();
+			double ms = 1000.0/SDL_GetPerformanceFrequency();
+
+			soak.sample(tickCount, (updated-start)*ms, (built-updated)*ms);
+			if(soak.isFinished()) is_running = false;
+		}
+
+		Profiler::get().endFrame();
+		AllocTracker::get().endTick();
+	}
+
+	//Reports heap use since the last report, then starts counting afresh. Does nothing unless memory=1
+	void writeMemoryReport(string title){
+		AllocTracker &tracker = AllocTracker::get();
+		if(!tracker.isEnabled()) return;
+
+		if(memoryReport==""){
+			tracker.report(cout, title);
+		} else {
+			ofstream out(memoryReport, ios::app);
+			if(!out) throw Exception("Could not open memory report " + memoryReport);
+			tracker.report(out, title);
+		}
+
+		tracker.resetLevel();
+	}
+
+	void queueInput(SDL_Event &e){
+		//Live input is dropped during playback, the log already holds every key that mattered
+		if(replay.isPlaying()) return;
+
+		//A full queue means the physics thread is behind, wait for it rather than lose a key up
+		while(!input.push(e) && is_running) SDL_Delay(1);
+	}
+
+	//Returns once the physics and render threads are asleep, so the caller may touch the renderer and the simulation
+	void pause(){
+		SDL_LockMutex(pauseMutex);
+		paused = true;
+		while(parked < loops) SDL_CondWait(parkedCond, pauseMutex);
+		SDL_UnlockMutex(pauseMutex);
+	}
+
+	void resume(){
+		SDL_LockMutex(pauseMutex);
+		paused = false;
+		SDL_CondBroadcast(resumed);
+		SDL_UnlockMutex(pauseMutex);
+	}
+
+	//Blocks the calling thread until the game is resumed or stopped. Returns true if it had to wait
+	bool waitWhilePaused(){
+		bool waited = false;
+
+		SDL_LockMutex(pauseMutex);
+		if(paused && is_running){
+			parked++;
+			SDL_CondSignal(parkedCond);
+			while(paused && is_running) SDL_CondWait(resumed, pauseMutex);
+			parked--;
+			waited = true;
+		}
+		SDL_UnlockMutex(pauseMutex);
+
+		return waited;
+	}
+
+	//Called by a loop as it returns, a pause() in progress stops waiting for it
+	void leaveLoop(){
+		SDL_LockMutex(pauseMutex);
+		loops--;
+		SDL_CondSignal(parkedCond);
+		SDL_UnlockMutex(pauseMutex);
+	}
+
 	static int physicsLoop(void *ptr /*type stripped point to the class */){
 		int newTicks;
 
 		Game *g = (Game *)ptr;
 		g->ticks = SDL_GetTicks();
+		Profiler::get().nameThread("Physics");
 
 		while (g->is_running){
+			//Time spent paused is not simulated
+			if(g->waitWhilePaused()) g->ticks = SDL_GetTicks();
+
 		  	newTicks = SDL_GetTicks();
 			double dt = double(newTicks-g->ticks)/1000.0;
 
-			g->update(dt);
+			g->tick(dt);
 			SDL_Delay(10);
 
 			g->ticks = newTicks;
 		}
+		g->leaveLoop();
 
 		return 0;
 	}
 
 	static int renderLoop(void *ptr){
 		Game *g = (Game *)ptr;
+		Profiler::get().nameThread("Render");
 
 		while (g->is_running){
-		  	g->render();
+			g->waitWhilePaused();
+
+			//Only redrawn when the physics thread has finished a new frame
+			DrawList *frame = g->frames.acquire();
+
+			if(frame){
+				Uint64 start = SDL_GetPerformanceCounter();
+			  	g->render(*frame);
+				g->soak.drawn((SDL_GetPerformanceCounter()-start)*1000.0/SDL_GetPerformanceFrequency());
+				g->latency.presented(frame->tick);
+
+				Profiler::get().endFrame();
+			}
 			SDL_Delay(10);
 		}
+		g->leaveLoop();
 
 		return 0;
 	}
@@ -69,34 +264,96 @@ class Game {
 		int newTicks;
 		is_running = true;
 		SDL_Event e;
+		loops = 2;
         
 		SDL_Thread *physicsThread=SDL_CreateThread(Game::physicsLoop,"Physics",(void *)this);
 		SDL_Thread *renderThread=SDL_CreateThread(Game::renderLoop,"Render",(void *) this);
 		
+		Uint32 lastTitleUpdate = SDL_GetTicks();
+
 		while (is_running){
-			while (SDL_PollEvent(&e)){
-				if (e.type == SDL_QUIT) 
-					is_running = false;
-				else if (e.type==SDL_KEYDOWN) handleKeyDown(e);
-				else if (e.type==SDL_KEYUP) handleKeyUp(e);
+			//Live latency percentiles go in the title bar, updated once a second
+			if(latency.isEnabled() && SDL_GetTicks()-lastTitleUpdate >= 1000){
+				SDL_SetWindowTitle(window, (title + " - " + latency.summary()).c_str());
+				lastTitleUpdate = SDL_GetTicks();
 			}
+
+			//Sleeps until there is input, then takes everything that has arrived
+			if(SDL_WaitEventTimeout(&e, INPUT_WAIT_MS)){
+				do{
+					if (e.type == SDL_QUIT) 
+						is_running = false;
+					else if ((e.type==SDL_KEYDOWN || e.type==SDL_KEYUP) && !handleUiKey(e)) queueInput(e);
+				} while(SDL_PollEvent(&e));
+			}
+
+			reloadContent();
 		}
 
+		//Wakes the threads if the game was stopped while paused
+		resume();
+
 		int retVal;
 		SDL_WaitThread(physicsThread,&retVal);
 		SDL_WaitThread(renderThread,&retVal);
+
+		replay.report();
+		if(traceFile!="") Profiler::get().writeTrace(traceFile);
+		if(latencyReport!="") latency.writeReport(latencyReport);
 	}
 
+	//Steps the simulation as fast as it will go with a fixed dt, there is no render or input thread.
+	//A replay runs until its log ends and ignores maxTicks and dt
+	void runHeadless(int maxTicks, double dt){
+		is_running = true;
+		Profiler::get().nameThread("Physics");
+
+		Uint64 start = SDL_GetPerformanceCounter();
+		int startTick = tickCount;
+
+		while(is_running && (replay.isPlaying() || tickCount-startTick < maxTicks)){
+			tick(dt);
+			reloadContent();
+		}
+
+		double seconds = double(SDL_GetPerformanceCounter()-start)/SDL_GetPerformanceFrequency();
+		int ran = tickCount-startTick;
+
+		cout << "Headless: " << ran << " ticks in " << seconds << "s (" << ran/seconds << " ticks/s)" << endl;
+
+		replay.report();
+		if(traceFile!="") Profiler::get().writeTrace(traceFile);
+	}
+
+	bool isHeadless(){ return headless; }
+
+	//Checksum of the simulation state, compared between a recording and its replay
+	virtual unsigned long long stateHash(){ return 0; }
+
+	//Keys that drive menus rather than the simulation are handled straight away on the main thread
+	virtual bool handleUiKey(SDL_Event key){ return false; }
+
+	//Main thread, between input batches (or between ticks when headless): picks up content edited on disk
+	virtual void reloadContent(){}
+
 	virtual void update(double dt /*s of elapsed time*/) = 0;
-	virtual void render() = 0;
+	//Physics thread, after each tick: describes what the screen should show. The game's objects may only be read here
+	virtual void buildFrame(DrawList &frame) = 0;
+	//Render thread: draws a finished frame, without touching the simulation
+	virtual void render(DrawList &frame) = 0;
 
 	virtual void handleKeyUp(SDL_Event key) = 0;
 	virtual void handleKeyDown(SDL_Event key) = 0;
     
 	~Game(){
-		SDL_DestroyRenderer(ren);
-		SDL_DestroyWindow(window);
-		Mix_CloseAudio();
+		if(!headless){
+			SDL_DestroyRenderer(ren);
+			SDL_DestroyWindow(window);
+			Mix_CloseAudio();
+		}
+		SDL_DestroyCond(resumed);
+		SDL_DestroyCond(parkedCond);
+		SDL_DestroyMutex(pauseMutex);
 		SDL_Quit();	
 	}
 };
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <SDL.h>
+#include <SDL_mutex.h>
+
+using namespace std;
+
+struct PendingInput{
+	Uint32 timestamp; //SDL event timestamp, ms
+	Uint32 consumedAt; //ms when the physics tick applied it
+	int tick; //the tick that applied it
+};
+
+//Follows each key event from its SDL timestamp, through the physics tick that applies it,
+//to the first SDL_RenderPresent showing that tick. Enable with latency=1, latencyReport=<file> writes a summary on exit
+class LatencyTracker{
+	vector<PendingInput> pending;
+	vector<double> toTick, toPresent;
+	SDL_mutex *mutex;
+
+	atomic<bool> enabled;
+
+	static double percentile(vector<double> samples, double p){
+		if(samples.empty()) return 0;
+
+		size_t n = min(samples.size()-1, (size_t)(p*samples.size()));
+		nth_element(samples.begin(), samples.begin()+n, samples.end());
+
+		return samples[n];
+	}
+
+	public:
+	LatencyTracker(){
+		mutex = SDL_CreateMutex();
+		enabled = false;
+	}
+
+	bool isEnabled(){ return enabled; }
+	void setEnabled(bool newEnabled){ enabled = newEnabled; }
+
+	//Physics thread, for each live input applied at the start of tick
+	void consumed(SDL_Event &e, int tick){
+		//Replayed input carries no timestamp and is not measured
+		if(!enabled || e.common.timestamp == 0) return;
+
+		SDL_LockMutex(mutex);
+		pending.push_back({e.common.timestamp, SDL_GetTicks(), tick});
+		SDL_UnlockMutex(mutex);
+	}
+
+	//Render thread, right after SDL_RenderPresent for a frame that showed shownTick
+	void presented(int shownTick){
+		if(!enabled) return;
+
+		Uint32 now = SDL_GetTicks();
+
+		SDL_LockMutex(mutex);
+		for(int i=pending.size()-1; i>=0; i--){
+			if(pending[i].tick <= shownTick){
+				toTick.push_back(pending[i].consumedAt-pending[i].timestamp);
+				toPresent.push_back(now-pending[i].timestamp);
+
+				pending.erase(pending.begin()+i);
+			}
+		}
+		SDL_UnlockMutex(mutex);
+	}
+
+	string summary(){
+		SDL_LockMutex(mutex);
+		vector<double> present = toPresent;
+		SDL_UnlockMutex(mutex);
+
+		return "input->present p50 " + to_string((int)percentile(present, 0.5)) + " ms p99 "
+			+ to_string((int)percentile(present, 0.99)) + " ms (" + to_string(present.size()) + " inputs)";
+	}
+
+	void writeReport(string filename){
+		SDL_LockMutex(mutex);
+		vector<double> tick = toTick;
+		vector<double> present = toPresent;
+		SDL_UnlockMutex(mutex);
+
+		ofstream out(filename);
+		if(!out) throw Exception("Could not open latency report " + filename);
+
+		out << "stage samples p50_ms p90_ms p99_ms max_ms\n";
+		out << "input_to_tick " << tick.size() << " " << percentile(tick, 0.5) << " " << percentile(tick, 0.9)
+			<< " " << percentile(tick, 0.99) << " " << percentile(tick, 1.0) << "\n";
+		out << "input_to_present " << present.size() << " " << percentile(present, 0.5) << " " << percentile(present, 0.9)
+			<< " " << percentile(present, 0.99) << " " << percentile(present, 1.0) << "\n";
+	}
+
+	~LatencyTracker(){
+		SDL_DestroyMutex(mutex);
+	}
+};
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+
+#include "Exception.hpp"
+#include "Config.hpp"
+#include "Random.hpp"
+
+#define GEN_MIN_COLS 40
+#define GEN_MAX_COLS 10000
+#define GEN_MIN_ROWS 16
+#define GEN_MAX_ROWS 1000
+
+#define GEN_START_COL 3 //where the player starts, on the ground at the left end
+#define GEN_SKY_ROWS 2 //empty rows at the top, lightning still needs somewhere to strike
+
+using namespace std;
+
+//Everything that shapes a generated level. The size and seed come from the level option, the rest from
+//config/generator.conf
+struct LevelGenSpec{
+	unsigned long long seed;
+	int cols, rows;
+	double density; //share of each tier's width covered by platforms
+	int npcs, bigNpcs, keys;
+	int tierSpacing; //rows from one tier of platforms up to the next, at least 4 so the player fits under a platform
+	int platformMin, platformMax; //tiles long
+	int pitMax; //widest hole in the ground, at most 3 so it can always be jumped
+	double stairChance; //chance a platform gets a staircase up to it from the tier below
+};
+
+//Writes seeded levels in the same text format as levels/level<N>.txt, for testing how the game scales with level
+//size. The ground runs the whole width with holes no wider than a jump, and the player starts at its left end with a
+//key and the door further along it, so every level can be finished. Tiers of platforms, joined by staircases, fill
+//the height above, and NPCs are spread over the ground and the platforms
+class LevelGenerator{
+	LevelGenSpec spec;
+	Random rng;
+	vector<string> cells;
+	int groundRow;
+	int keyCol, doorCol;
+	vector<bool> keepGround; //ground columns a hole may not be cut in
+	vector<bool> keepOpen; //columns with nothing on or above the ground below the second tier, so the key and door are walked into
+
+	int between(int lo, int hi){ return lo + rng.range(hi-lo+1); }
+
+	bool solid(int col, int row){
+		if(col < 0 || row < 0 || col >= spec.cols || row >= spec.rows) return false;
+		return cells[row][col] != '0';
+	}
+
+	//Whether a character standing on the floor at (col, row) has height rows clear above it
+	bool standable(int col, int row, int height){
+		if(!solid(col, row)) return false;
+
+		for(int r=row-height; r<row; r++)
+			if(r < 0 || solid(col, r)) return false;
+
+		return true;
+	}
+
+	void platforms(int row, bool fromGround){
+		int steps = spec.tierSpacing-1;
+		int col = 2, lastEnd = 0;
+
+		while(col < spec.cols-3){
+			int length = between(spec.platformMin, spec.platformMax);
+			int meanGap = max(1, (int)(length*(1-spec.density)/spec.density));
+			col += between(max(1, meanGap/2), meanGap+meanGap/2);
+
+			int end = min(spec.cols-3, col+length);
+			if(end-col < 2) break;
+
+			//Steps climb one row every two columns from the tier below up to the platform's left end, so they need
+			//a floor under the bottom step and the last platform far enough back to leave headroom over them.
+			//From the ground they stay clear of where the player starts
+			int foot = col-2*steps;
+			bool stairs = foot-1 >= max(2, lastEnd) && rng.range(1000) < spec.stairChance*1000;
+			if(stairs && !fromGround) stairs = solid(foot, row+spec.tierSpacing) && solid(foot+1, row+spec.tierSpacing);
+			if(fromGround && foot < GEN_START_COL+4) stairs = false;
+
+			if(fromGround){
+				bool open = true;
+				for(int c=max(0, (stairs ? foot : col)-1); open && c<=end; c++) open = !keepOpen[c];
+
+				if(!open){
+					col = end;
+					continue;
+				}
+			}
+
+			for(int c=col; c<end; c++) cells[row][c] = 'f';
+			lastEnd = end;
+
+			if(stairs){
+				for(int k=1; k<=steps; k++){
+					int r = row+k, c = col-2*k;
+					cells[r][c] = 'f';
+					cells[r][c+1] = 'f';
+				}
+
+				//A hole under the bottom step or where the climber lands could not be got out of
+				if(fromGround) for(int c=foot-2; c<col+2; c++) keepGround[c] = true;
+			}
+
+			//Walking off a first tier platform drops the player back to the ground, which must be there
+			if(fromGround){
+				for(int c=max(0, col-4); c<min(spec.cols, col+2); c++) keepGround[c] = true;
+				for(int c=max(0, end-2); c<min(spec.cols, end+4); c++) keepGround[c] = true;
+			}
+
+			col = end;
+		}
+	}
+
+	//Holes between runs of ground, never where keepGround says the ground is needed
+	void pits(){
+		if(spec.pitMax <= 0) return;
+
+		int col = between(6, 30);
+		while(col < spec.cols-2){
+			int width = between(1, spec.pitMax);
+
+			bool clear = col+width < spec.cols-1;
+			for(int c=col-1; clear && c<=col+width; c++) clear = !keepGround[c];
+
+			if(clear) for(int c=col; c<col+width; c++) cells[groundRow][c] = '0';
+
+			col += width + between(6, 30);
+		}
+	}
+
+	//Tries random spots until the character fits, giving up after enough misses on a crowded level
+	bool place(char c, int height){
+		int tiers = (groundRow-GEN_SKY_ROWS)/spec.tierSpacing;
+
+		for(int tries=0; tries<200; tries++){
+			int row = groundRow - spec.tierSpacing*rng.range(tiers+1);
+			int col = between(1, spec.cols-2);
+
+			if(row <= GEN_SKY_ROWS || !standable(col, row, height) || cells[row-1][col] != '0') continue;
+
+			cells[row-1][col] = c;
+			return true;
+		}
+
+		return false;
+	}
+
+	public:
+	LevelGenerator(LevelGenSpec newSpec){
+		spec = newSpec;
+		spec.cols = max(GEN_MIN_COLS, min(GEN_MAX_COLS, spec.cols));
+		spec.rows = max(GEN_MIN_ROWS, min(GEN_MAX_ROWS, spec.rows));
+		spec.density = max(0.05, min(0.95, spec.density));
+		spec.tierSpacing = max(4, spec.tierSpacing);
+		spec.platformMin = max(2, spec.platformMin);
+		spec.platformMax = max(spec.platformMin, spec.platformMax);
+		spec.pitMax = max(0, min(3, spec.pitMax));
+		spec.keys = max(1, spec.keys);
+
+		rng.seed(spec.seed, "levelGenerator");
+	}
+
+	//Reads the option form gen:<seed>:<cols>x<rows> on top of the settings in config/generator.conf.
+	//False if option is not a generated level at all
+	static bool parse(string option, LevelGenSpec &spec){
+		if(option.compare(0, 4, "gen:") != 0) return false;
+
+		size_t colon = option.find(':', 4), x = option.find('x', colon+1);
+		if(colon == string::npos || x == string::npos) throw Exception("Expected gen:<seed>:<cols>x<rows>, got " + option);
+
+		try{
+			spec.seed = stoull(option.substr(4, colon-4));
+			spec.cols = stoi(option.substr(colon+1, x-colon-1));
+			spec.rows = stoi(option.substr(x+1));
+		} catch(exception &e){
+			throw Exception("Expected gen:<seed>:<cols>x<rows>, got " + option);
+		}
+
+		Config conf("generator");
+		spec.density = stod(conf["density"]);
+		spec.npcs = stoi(conf["npcs"]);
+		spec.bigNpcs = stoi(conf["bigNpcs"]);
+		spec.keys = stoi(conf["keys"]);
+		spec.tierSpacing = stoi(conf["tierSpacing"]);
+		spec.platformMin = stoi(conf["platformMin"]);
+		spec.platformMax = stoi(conf["platformMax"]);
+		spec.pitMax = stoi(conf["pitMax"]);
+		spec.stairChance = stod(conf["stairChance"]);
+
+		return true;
+	}
+
+	//Level rows, top first
+	vector<string> &generate(){
+		cells.assign(spec.rows, string(spec.cols, '0'));
+		groundRow = spec.rows-3; //the two rows below are what the player falls through when they miss a jump
+		keepGround.assign(spec.cols, false);
+		keepOpen.assign(spec.cols, false);
+
+		for(int c=0; c<spec.cols; c++) cells[groundRow][c] = 'f';
+
+		//Walls at both ends up to the top tier
+		for(int r=GEN_SKY_ROWS; r<groundRow; r++){
+			cells[r][0] = 'r';
+			cells[r][spec.cols-1] = 'l';
+		}
+
+		//Start, key and door all stand on open ground that no hole is cut in, with the key between the other two
+		doorCol = spec.cols-4;
+		keyCol = between(max(GEN_START_COL+2, spec.cols/3), doorCol-3);
+		for(int c=0; c<GEN_START_COL+4; c++) keepGround[c] = true;
+		for(int c=keyCol-3; c<=keyCol+3; c++) keepGround[c] = keepOpen[c] = true;
+		for(int c=doorCol-6; c<spec.cols; c++) keepGround[c] = keepOpen[c] = true;
+
+		for(int t=1; groundRow-t*spec.tierSpacing > GEN_SKY_ROWS; t++) platforms(groundRow-t*spec.tierSpacing, t==1);
+
+		pits();
+
+		cells[groundRow-2][GEN_START_COL] = 'p';
+		cells[groundRow-1][keyCol] = 'k';
+		cells[groundRow-2][doorCol] = 'd';
+
+		for(int i=1; i<spec.keys; i++) place('k', 1);
+		for(int i=0; i<spec.npcs; i++) place('e', 2);
+		for(int i=0; i<spec.bigNpcs; i++) place('b', 4);
+
+		return cells;
+	}
+
+	//Generates the level into a file next to the shipped ones and returns its name
+	string write(){
+		string filename = "levels/gen_" + to_string(spec.seed) + "_" + to_string(spec.cols) + "x" + to_string(spec.rows) + ".txt";
+
+		ofstream out(filename, ios::binary);
+		if(!out) throw Exception("Could not write generated level " + filename);
+
+		for(auto &row:generate()) out << row << '\n';
+		cells.clear();
+
+		return filename;
+	}
+};
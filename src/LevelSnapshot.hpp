@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include "EntityStore.hpp"
+#include "ChunkStreamer.hpp"
+#include "TimerWheel.hpp"
+
+using namespace std;
+
+//What a chunk holds that is not rebuilt from the level file
+struct ChunkSnapshot{
+	bool resident, visited;
+	vector<EntityRecord> npcs, keys;
+};
+
+//A tile still fading from being lit, by grid cell
+struct TileLight{
+	int col, row;
+	double litAt;
+};
+
+//A level as it stood at one moment, taken by Map::checkpoint and put back by Map::restore without touching the disk.
+//Entity stores are copied whole, array by array. Tiles are not kept, only which were lit. Live waves are not kept
+//either, a restore clears them. Only valid for the Map that took it, its timers call back into that Map
+struct LevelSnapshot{
+	EntityStore npcs, keys;
+	vector<ChunkSnapshot> chunks;
+	vector<TileLight> lit;
+	TimerWheel timers;
+	unsigned long long lightningState;
+	double flashedAt;
+	int flashX;
+
+	double playerX, playerY;
+	bool playerHasKey;
+
+	LevelSnapshot(EntityStore &newNpcs, EntityStore &newKeys):npcs(newNpcs), keys(newKeys){
+		lightningState = 0;
+		flashedAt = 0;
+		flashX = 0;
+		playerX = 0;
+		playerY = 0;
+		playerHasKey = false;
+	}
+};
@@ -8,6 +8,9 @@
 #include "Animation.hpp"
 #include "MediaManager.hpp"
 #include "Config.hpp"
+#include "DrawList.hpp"
+#include "TimerWheel.hpp"
+#include "Names.hpp"
 
 using namespace std;
 
@@ -16,12 +19,15 @@ class Lightning:public Particle{
     SDL_Renderer *ren;
     MediaManager *media;
 
-    map<string,Animation *> animations;
-    map<string, Mix_Chunk *> sounds;
+    NameTable<Animation *> animations;
+    NameTable<Mix_Chunk *> sounds;
   
     protected:
     Animation *a;
     SDL_Rect dest;
+    double flashedAt; //s on the map's clock, the flash fades by fadeRate alpha per second from then
+    double fadeRate;
+    double interval, thunderDelay; //mean s between strikes, and from a flash to its thunder
 
     public:
     Lightning(MediaManager *newMedia, SDL_Renderer *newRen, Config *newCfg,
@@ -40,53 +46,64 @@ class Lightning:public Particle{
         vector<string> newAnimations = cfg->getMany("animations");
 
         for(auto anim: newAnimations){
-            animations[anim] = new Animation(0);
-            animations[anim]->readAnimation(media, anim);
+            Animation *newA = new Animation(0);
+            newA->readAnimation(media, anim);
+            animations.set(Names::get().id(anim), newA);
         }
 
-        a = animations[(*cfg)["defaultAnimation"]];
+        a = animations[Names::get().id((*cfg)["defaultAnimation"])];
         
         vector<string> newSounds = cfg->getMany("sounds");
 
         for(auto sound: newSounds){
-            sounds[sound] = new Mix_Chunk();
-            sounds[sound] = media->readSound(sound);
+            sounds.set(Names::get().id(sound), media->readSound(sound));
         }
 
         y = 0;
-        a->setTransparency(0);
+        flashedAt = -INFINITY;
+        configure();
+        dest.x = x;
+        dest.y = y;
+    }
+
+    void configure(){
+        fadeRate = stod((*cfg)["fadeRate"]);
+        interval = stod((*cfg)["interval"]);
+        thunderDelay = stod((*cfg)["thunderDelay"]);
     }
 
+    double getInterval(){ return interval; }
+    double getThunderDelay(){ return thunderDelay; }
+
     SDL_Rect *getDest(){ return &dest; }
     
     Animation *getAnimation(){ return a; }
     void setAnimation(Animation *newA){ a = newA; }
 
-    void update(double dt, vector<Tile *>&tiles , bool flashed=0, int newX=0){
-        if (flashed){
-            x = newX;
-            a->setTransparency(255);
-        }
-
-        if(a->getTransparency() > 0) a->decTransparency(3);
+    void flash(double now, int newX){
+        flashedAt = now;
+        x = newX;
+        dest.x = x;
+    }
 
-        if (a->getTransparency() == 60){
-            Mix_PlayChannel(-1,sounds["thunder"],0);
-            for (auto &t:tiles) t->lightUp(); 
-        }
+    //Scheduled a little after the flash, thunder lights up every tile
+    void thunder(vector<Tile *>&tiles){
+        media->playSound(sounds[NAME_THUNDER]);
+        for (auto &t:tiles) t->lightUp();
+    }
 
-        a->update(dt);
+    double getFlashedAt(){ return flashedAt; }
+    int alphaAt(double now){ return (int)max(0.0, 255-fadeRate*(now-flashedAt)); }
 
-        dest.x = x;
-        dest.y = y;
-    }
+    //Drawn over the whole screen rather than at a place in the level
+    void render(DrawList &frame, double now){
+        int alpha = alphaAt(now);
+        if(alpha <= 0) return;
 
-    void render(){
-        SDL_RenderCopy(ren, a->getTexture(), a->getFrame(), &dest);
+        frame.sprite(a->getTexture(), a->getFrame(a->advance(0, now-flashedAt)), dest, alpha);
     }
 
     ~Lightning(){
-        for (auto a:animations) delete a.second;
-        for (auto s:sounds) delete s.second;
+        for (auto a:animations.all()) delete a;
     }
 };
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <SDL_mixer.h>
 #include <SDL.h>
 
@@ -10,11 +11,28 @@
 #include "Animation.hpp"
 #include "Wave.hpp"
 #include "Player.hpp"
-#include "NPC.hpp"
-#include "Key.hpp"
+#include "EntityStore.hpp"
+#include "TileGrid.hpp"
+#include "FlowField.hpp"
+#include "AcousticField.hpp"
 #include "Tile.hpp"
 #include "Config.hpp"
 #include "Lightning.hpp"
+#include "Random.hpp"
+#include "Profiler.hpp"
+#include "AllocTracker.hpp"
+#include "Replay.hpp"
+#include "Camera.hpp"
+#include "DrawList.hpp"
+#include "ChunkStreamer.hpp"
+#include "TimerWheel.hpp"
+#include "LevelSnapshot.hpp"
+#include "LevelGenerator.hpp"
+
+//Chunks the loader has read that are turned into tiles and entities each tick
+#define CHUNKS_PER_TICK 1
+//Acoustic sources brought up to date with newly loaded or evicted chunks each tick
+#define ACOUSTIC_CELLS_PER_TICK 256
 
 
 class Map{
@@ -24,39 +42,79 @@ class Map{
 
     Waves *waves;
 
-    map<string, Config *>npcConfs;
-    vector<Npc *>npcs;
-
-    map<string, Config *>keyConfs;
-    vector<Key *>keys;
-
-    map<string,Config *> tileConfs;
-    vector<Tile *>tiles;
+    //NPC and key configs by the level character they are placed with, NULL for every other type
+    Config *entityConfs[TILE_TYPE_COUNT];
+    EntityArchetype *entityTypes[TILE_TYPE_COUNT];
+    EntityStore npcs;
+    EntityStore keys;
+
+    Config *tileConf;
+    TileArchetype *tileKind;
+    vector<Tile *>tiles; //tiles of the resident chunks
+    TileGrid grid;
+
+    ChunkStreamer *streamer;
+    vector<LevelChunk> chunks;
+    int chunkCache, residentCount;
+    bool syncStreaming;
+    long streamClock;
+    vector<FlowField *> flows;
+    AcousticField *acoustics;
 
     Config *lightningConf;
     Lightning *lightning;
+    Random lightningRng;
+
+    //Timed effects run on the level's own clock, advanced by each update's dt, so they keep time at any tick rate
+    TimerWheel timers;
 
     int playerStartX, playerStartY;
     int tileWidth;
+    int width, height; //level size in pixels, from the level file
+
+    //Entities further than throttleRadius from the player update every throttleInterval ticks, 0 never throttles
+    int throttleRadius, throttleInterval;
 
     public:
-    Map(MediaManager *newMedia, SDL_Renderer *newRen, Waves* newWaves, Config *newCfg){
+    Map(MediaManager *newMedia, SDL_Renderer *newRen, Waves* newWaves, Config *newCfg, unsigned long long seed=0):
+        npcs(newWaves, true, true), keys(newWaves, false, false){
         media = newMedia;
+        lightningRng.seed(seed, "lightning");
         ren = newRen;
         cfg = newCfg;
 
         waves = newWaves;
+        acoustics = NULL;
+        width = 0;
+        height = 0;
+        throttleRadius = 0;
+        throttleInterval = 1;
+
+        streamer = NULL;
+        chunkCache = 25;
+        residentCount = 0;
+        syncStreaming = true;
+        streamClock = 0;
         
-        npcConfs["basic"] = (new Config("npc"));
-        npcConfs["big"] = (new Config("bigNpc"));
-        
-        tileConfs["tile"] = (new Config("tile"));
-        tileWidth=stoi((*tileConfs["tile"])["width"]);
+        for (int i=0; i<TILE_TYPE_COUNT; i++){
+            entityConfs[i] = NULL;
+            entityTypes[i] = NULL;
+        }
 
-        keyConfs["key"] = (new Config("key"));
+        entityConfs[TILE_NPC] = new Config("npc");
+        entityConfs[TILE_BIG_NPC] = new Config("bigNpc");
+        entityConfs[TILE_KEY] = new Config("key");
+        for (int i=0; i<TILE_TYPE_COUNT; i++)
+            if(entityConfs[i]) entityTypes[i] = new EntityArchetype(media, waves, entityConfs[i]);
+        
+        tileConf = new Config("tile");
+        tileKind = new TileArchetype(media, tileConf);
+        tileWidth = tileKind->w;
+        grid = TileGrid(tileWidth);
 
         lightningConf = new Config("lightning");
         lightning = new Lightning(media, ren, lightningConf);
+        scheduleLightning();
     }
 
     Tile *operator[] (int index){
@@ -65,149 +123,512 @@ class Map{
 
     int getStartX(){ return playerStartX; }
     int getStartY(){ return playerStartY; }
+    int getWidth(){ return width; }
+    int getHeight(){ return height; }
+
+    //Bounds p to the level with a tile of margin, the edges every particle reflects off
+    void applyBound(Particle *p){
+        p->setBound(-tileWidth, -tileWidth, width+tileWidth, height+tileWidth);
+    }
 
-    void placeTile(int x, int y, string type){
-        if(type=="player"){
-            playerStartX = x;
-            playerStartY = y+16;
-        } else if(type=="basic" || type=="big"){
-            spawnNpc(x, y+tileWidth, type);
-        } else if(type=="key"){
-            spawnKey(x, y+tileWidth, type);
-        } else if(type!="empty"){
-            tiles.push_back(new Tile(media, ren, tileConfs["tile"], type, x, y));
+    void setThrottle(int newRadius, int newInterval){
+        throttleRadius = newRadius;
+        throttleInterval = max(1, newInterval);
+        npcs.setThrottle(throttleRadius, throttleInterval);
+        keys.setThrottle(throttleRadius, throttleInterval);
+    }
+
+    //Level characters to tile, entity and marker types
+    static TileType tileTypeOf(char c){
+        switch(c){
+            case 'l': //left wall
+                return TILE_LWALL;
+            case 'r': //right wall
+                return TILE_RWALL;
+            case 'f': //floor
+                return TILE_FLOOR;
+            case 'c': //ceiling
+                return TILE_CEILING;
+            case 'p': //player
+                return TILE_PLAYER;
+            case 'e': //enemy (basic)
+                return TILE_NPC;
+            case 'b': //big enemy
+                return TILE_BIG_NPC;
+            case 'k':
+                return TILE_KEY;
+            case 'd':
+                return TILE_DOOR;
+            default:
+                return TILE_EMPTY;
+        }
+    }
+
+    static bool isNpc(int type){ return type==TILE_NPC || type==TILE_BIG_NPC; }
+
+    //spawn is false when the chunk has been loaded before, its entities then come back from their records
+    void placeTile(LevelChunk &chunk, int x, int y, TileType type, bool spawn){
+        if(isNpc(type)){
+            if(spawn) spawnNpc(x, y+tileWidth, type);
+        } else if(type==TILE_KEY){
+            if(spawn) spawnKey(x, y+tileWidth, type);
+        } else if(type!=TILE_EMPTY && type!=TILE_PLAYER){
+            Tile *t = new Tile(tileKind, type, x, y);
+            t->setClock(&timers);
+            chunk.tiles.push_back(t);
+            tiles.push_back(t);
+            grid.insert(t);
         }
     }
 
-    void spawnNpc(int x, int y, string type){
-        npcs.push_back(new Npc(media, ren, waves, npcConfs[type], x, y));
+    void spawnNpc(int x, int y, TileType type){
+        npcs.create(entityTypes[type], x, y);
+    }
+    void spawnKey(int x, int y, TileType type){
+        keys.create(entityTypes[type], x, y);
     }
-    void spawnKey(int x, int y, string type){
-        keys.push_back(new Key(media, ren, waves, keyConfs[type],x, y));
+
+    //Sync streaming reads every chunk on the physics thread the tick it is needed, which keeps recordings and
+    //replays deterministic. cache is how many chunks may stay in memory, at least the 3x3 around the player
+    void setStreaming(int newChunkCache, bool newSync){
+        chunkCache = max(9, newChunkCache);
+        syncStreaming = newSync;
     }
 
     void initMap(int levelNum) {
-        string levelName = "level"+to_string(levelNum);
-        ifstream inf("levels/"+levelName+".txt");
-        string mapRow = "";
-
-        int placeX = 0;
-        int placeY = 0;
-
-        string tileType = "";
-
-        while(!inf.eof()){
-            getline(inf, mapRow);
-
-            for(char &c:mapRow){
-                switch(c){
-                    case 'l': //left wall
-                        tileType = "lWall";
-                        break;
-                    case 'r': //right wall
-                        tileType = "rWall";
-                        break;
-                    case 'f': //floor
-                        tileType = "floor";
-                        break;
-                    case 'c': //ceiling
-                        tileType = "ceiling";
-                        break;
-                    case 'p': //player
-                        tileType = "player";
-                        break;
-                    case 'e': //enemy (basic)
-                        tileType = "basic";
-                        break;
-                    case 'b': //big enemy
-                        tileType = "big";
-                        break;
-                    case 'k':
-                        tileType = "key";
-                        break;
-                    case 'd':
-                        tileType = "door";
-                        break;
-                    default:
-                        tileType = "empty";
+        loadLevel("levels/level"+to_string(levelNum)+".txt");
+    }
+
+    //Writes a level from spec and loads it like any other
+    void initGenerated(LevelGenSpec spec){
+        loadLevel(LevelGenerator(spec).write());
+    }
+
+    //Only the level file's row offsets are read up front. Tiles, NPCs and keys arrive a chunk at a time around the player
+    void loadLevel(string filename){
+        ALLOC_SCOPE(ALLOC_LEVEL);
+
+        streamer = new ChunkStreamer(filename);
+
+        width = streamer->getCols()*tileWidth;
+        height = streamer->getRows()*tileWidth;
+        playerStartX = streamer->getStartCol()*tileWidth;
+        playerStartY = streamer->getStartRow()*tileWidth+16;
+
+        grid.resize(streamer->getCols(), streamer->getRows());
+        chunks.assign(streamer->chunksX()*streamer->chunksY(), LevelChunk());
+
+        waves->setBound(-tileWidth, -tileWidth, width+tileWidth, height+tileWidth);
+        npcs.setBound(-tileWidth, -tileWidth, width+tileWidth, height+tileWidth);
+        keys.setBound(-tileWidth, -tileWidth, width+tileWidth, height+tileWidth);
+
+        for (int i=0; i<TILE_TYPE_COUNT; i++){
+            if(!isNpc(i)) continue;
+
+            EntityArchetype *t = entityTypes[i];
+            t->flow = new FlowField(&grid, t->h, t->baseSpeed, t->jumpSpeed);
+            flows.push_back(t->flow);
+        }
+
+        acoustics = new AcousticField(&grid);
+        waves->setListener(acoustics);
+
+        stream(playerStartX, playerStartY, true);
+        acoustics->refresh();
+        waves->resetPaths();
+        if(!syncStreaming) streamer->start();
+    }
+
+    int chunkAt(double x, double y){
+        int cx = min(streamer->chunksX()-1, max(0, (int)floor(x/tileWidth)/CHUNK_TILES));
+        int cy = min(streamer->chunksY()-1, max(0, (int)floor(y/tileWidth)/CHUNK_TILES));
+
+        return cy*streamer->chunksX()+cx;
+    }
+
+    void chunkCells(int index, int &c0, int &r0, int &c1, int &r1){
+        c0 = (index%streamer->chunksX())*CHUNK_TILES;
+        r0 = (index/streamer->chunksX())*CHUNK_TILES;
+        c1 = min(grid.getCols(), c0+CHUNK_TILES)-1;
+        r1 = min(grid.getRows(), r0+CHUNK_TILES)-1;
+    }
+
+    //Keeps the chunks around (x, y) resident, brings in what the loader has read and evicts the least recently
+    //used chunks once more than chunkCache are resident, pinned ones aside. wait reads missing chunks on this thread
+    void stream(double x, double y, bool wait=false){
+        PROFILE_SCOPE("Map::stream");
+        ALLOC_SCOPE(ALLOC_LEVEL);
+        streamClock++;
+
+        int centre = chunkAt(x, y);
+        int ccx = centre%streamer->chunksX(), ccy = centre/streamer->chunksX();
+
+        for (int cy=max(0, ccy-1); cy<=min(streamer->chunksY()-1, ccy+1); cy++){
+            for (int cx=max(0, ccx-1); cx<=min(streamer->chunksX()-1, ccx+1); cx++){
+                int index = cy*streamer->chunksX()+cx;
+                LevelChunk &chunk = chunks[index];
+                chunk.lastUsed = streamClock;
+
+                if(chunk.state == CHUNK_RESIDENT) continue;
+
+                if(wait || syncStreaming || !streamer->isStarted()){
+                    ChunkData data = streamer->load(index);
+                    materialize(data);
+                } else if(chunk.state == CHUNK_UNLOADED){
+                    streamer->request(index);
+                    chunk.state = CHUNK_REQUESTED;
                 }
+            }
+        }
+
+        //Building a chunk's tiles is the expensive part, so only a few are taken per tick
+        ChunkData data;
+        for (int i=0; i<CHUNKS_PER_TICK && streamer->poll(data); i++) materialize(data);
 
-                placeTile(placeX, placeY, tileType);
-                placeX += tileWidth;
+        while(residentCount > chunkCache){
+            int oldest = -1;
+            for (int i=0; i<chunks.size(); i++){
+                if(chunks[i].state != CHUNK_RESIDENT || chunks[i].pinned || chunks[i].lastUsed == streamClock) continue;
+                if(oldest < 0 || chunks[i].lastUsed < chunks[oldest].lastUsed) oldest = i;
             }
 
-            placeX = 0;
-            placeY += tileWidth;
+            if(oldest < 0) break;
+            evict(oldest);
         }
+
+        acoustics->refresh(ACOUSTIC_CELLS_PER_TICK);
+        saveStrayEntities();
     }
 
-    void updateNpcs(double dt, Player *player){
-        for (auto& e:npcs){
-            e->update(dt, player->getX());
-            e->collisions(tiles);
+    void materialize(ChunkData &data){
+        LevelChunk &chunk = chunks[data.index];
+        if(chunk.state == CHUNK_RESIDENT) return;
+
+        PROFILE_SCOPE("Map::materialize");
+        ALLOC_SCOPE(ALLOC_TILES);
+
+        int c0, r0, c1, r1;
+        chunkCells(data.index, c0, r0, c1, r1);
+        grid.loadChunk(c0, r0);
+
+        for (int r=0; r<data.rows.size(); r++)
+            for (int c=0; c<data.rows[r].size(); c++)
+                placeTile(chunk, (c0+c)*tileWidth, (r0+r)*tileWidth, tileTypeOf(data.rows[r][c]), !chunk.visited);
+
+        //Doors on the bottom row of the chunk above reach down into this one
+        int above = data.index-streamer->chunksX();
+        if(above >= 0 && chunks[above].state == CHUNK_RESIDENT)
+            for (auto t:chunks[above].tiles)
+                if(t->getY()+t->getH() > r0*tileWidth) grid.insert(t);
+
+        for (auto &e:chunk.npcs) npcs.create(e.type, e.x, e.y);
+        for (auto &e:chunk.keys) keys.create(e.type, e.x, e.y);
+        chunk.npcs.clear();
+        chunk.keys.clear();
+
+        chunk.visited = true;
+        chunk.state = CHUNK_RESIDENT;
+        residentCount++;
+
+        tilesChanged(c0, r0, c1, r1);
+    }
+
+    void evict(int index){
+        PROFILE_SCOPE("Map::evict");
+        ALLOC_SCOPE(ALLOC_TILES);
+
+        LevelChunk &chunk = chunks[index];
+
+        int c0, r0, c1, r1;
+        chunkCells(index, c0, r0, c1, r1);
+
+        saveEntities(npcs, index, chunk.npcs);
+        saveEntities(keys, index, chunk.keys);
+
+        //Removed one by one first for the doors that reach into the chunk below
+        for (auto t:chunk.tiles) grid.remove(t);
+        grid.unloadChunk(c0, r0);
+        for (auto f:flows) f->unloadChunk(c0, r0);
+        acoustics->unloadChunk(c0, r0);
+
+        tiles.erase(remove_if(tiles.begin(), tiles.end(), [&](Tile *t){ return chunkAt(t->getX(), t->getY())==index; }), tiles.end());
+        for (auto t:chunk.tiles) delete t;
+        chunk.tiles.clear();
+
+        chunk.state = CHUNK_UNLOADED;
+        residentCount--;
+
+        tilesChanged(c0, r0, c1, r1);
+    }
+
+    void tilesChanged(int c0, int r0, int c1, int r1){
+        acoustics->tilesChanged(c0, r0, c1, r1);
+        for (auto f:flows) f->tilesChanged(c0, r0, c1, r1);
+        waves->invalidatePaths(c0*tileWidth, r0*tileWidth, (c1+1)*tileWidth, (r1+1)*tileWidth);
+    }
+
+    //The chunk an entity belongs to is the one under its feet
+    int entityChunk(EntityStore &store, int i){
+        SDL_Rect dest = store.getDest(i);
+        return chunkAt(dest.x+dest.w/2, dest.y+dest.h-1);
+    }
+
+    void saveEntities(EntityStore &store, int index, vector<EntityRecord> &records){
+        for (int i=store.size()-1; i>=0; i--){
+            if(entityChunk(store, i) != index) continue;
+
+            SDL_Rect dest = store.getDest(i);
+            records.push_back({store.getArchetype(i), store.getX(i), store.getY(i)+dest.h});
+            store.removeAt(i);
         }
+    }
 
-        vector<int> locations;
+    //An entity that wandered into a chunk that is not in memory waits in that chunk's records until it returns
+    void saveStrayEntities(){
+        EntityStore *stores[2] = {&npcs, &keys};
 
-        for (int i=0; i<npcs.size(); i++){
-            if (npcs[i]->collide(player->getDest())) locations.push_back(i-locations.size());
+        for (auto store:stores){
+            for (int i=store->size()-1; i>=0; i--){
+                int index = entityChunk(*store, i);
+                if(chunks[index].state == CHUNK_RESIDENT) continue;
+
+                SDL_Rect dest = store->getDest(i);
+                EntityRecord record = {store->getArchetype(i), store->getX(i), store->getY(i)+dest.h};
+
+                (store==&npcs ? chunks[index].npcs : chunks[index].keys).push_back(record);
+                store->removeAt(i);
+            }
         }
+    }
 
-        for (auto i:locations) npcs.erase(npcs.begin()+i);
-      }
+    int residentChunks(){ return residentCount; }
 
-    void updateKey(double dt, Player *player){
-        for (auto& k:keys) k->update(dt, player->getX());
+    //Re-reads config/<name>.conf if the level uses it and passes the new values on to what was built from it.
+    //False when the level has no such config
+    bool reloadConfig(string name){
+        bool found = false;
+
+        if(tileConf->getName() == name){
+            tileConf->reload([&]{ tileKind->configure(); });
+            found = true;
+        }
 
-        vector<int> locations;
+        for (int i=0; i<TILE_TYPE_COUNT; i++){
+            if(entityConfs[i] == NULL || entityConfs[i]->getName() != name) continue;
 
-        for (int i=0; i<keys.size(); i++){
-            if(keys[i]->collide(player->getDest())){
-                locations.push_back(i-locations.size());
-                player->collectedKey();
+            EntityArchetype *type = entityTypes[i];
+            entityConfs[i]->reload([&]{ type->configure(); });
+
+            //Routes depend on the body's height and speeds, so its flow field is built again
+            if(type->flow){
+                FlowField *old = type->flow;
+                type->flow = new FlowField(&grid, type->h, type->baseSpeed, type->jumpSpeed);
+                replace(flows.begin(), flows.end(), old, type->flow);
+                delete old;
             }
+            found = true;
+        }
+
+        if(lightningConf->getName() == name){
+            lightningConf->reload([&]{ lightning->configure(); });
+            found = true;
+        }
+
+        return found;
+    }
+
+    //Everything about the level a restore needs to put it back as it is now, with the player where they stand
+    LevelSnapshot *checkpoint(Player *player){
+        PROFILE_SCOPE("Map::checkpoint");
+        ALLOC_SCOPE(ALLOC_LEVEL);
+
+        LevelSnapshot *s = new LevelSnapshot(npcs, keys);
+
+        for (auto &c:chunks) s->chunks.push_back({c.state == CHUNK_RESIDENT, c.visited, c.npcs, c.keys});
+        for (auto t:tiles)
+            if(t->getAlpha() > 0) s->lit.push_back({grid.colOf(t->getX()), grid.rowOf(t->getY()), t->getLitAt()});
+
+        s->timers = timers;
+        s->lightningState = lightningRng.getState();
+        s->flashedAt = lightning->getFlashedAt();
+        s->flashX = lightning->getX();
+
+        s->playerX = player->getX();
+        s->playerY = player->getY();
+        s->playerHasKey = player->getHasKey();
+
+        //The 3x3 a restore streams around the player stays in memory, a Map keeps one checkpoint at a time
+        int centre = chunkAt(s->playerX, s->playerY);
+        int ccx = centre%streamer->chunksX(), ccy = centre/streamer->chunksX();
+
+        for (int i=0; i<chunks.size(); i++)
+            chunks[i].pinned = abs(i%streamer->chunksX()-ccx) <= 1 && abs(i/streamer->chunksX()-ccy) <= 1;
+
+        return s;
+    }
+
+    //Puts the level back as s left it. Chunks resident now that were not then are evicted and chunks that were
+    //resident then but have since gone keep their entities as records, so streaming ends up where it was
+    void restore(LevelSnapshot &s, Player *player){
+        PROFILE_SCOPE("Map::restore");
+        ALLOC_SCOPE(ALLOC_LEVEL);
+
+        waves->deleteWaves();
+
+        for (int i=0; i<chunks.size(); i++)
+            if(chunks[i].state == CHUNK_RESIDENT && !s.chunks[i].resident) evict(i);
+
+        npcs = s.npcs;
+        keys = s.keys;
+
+        for (int i=0; i<chunks.size(); i++){
+            chunks[i].visited = s.chunks[i].visited;
+            chunks[i].npcs = s.chunks[i].npcs;
+            chunks[i].keys = s.chunks[i].keys;
         }
+        saveStrayEntities();
 
-        for (auto i:locations) keys.erase(keys.begin()+i);
+        for (auto t:tiles) t->setLitAt(-INFINITY);
+        for (auto &l:s.lit){
+            Tile *t = grid.at(l.col, l.row);
+            if(t) t->setLitAt(l.litAt);
+        }
+
+        timers = s.timers;
+        lightningRng.setState(s.lightningState);
+        lightning->flash(s.flashedAt, s.flashX);
+
+        player->setX(s.playerX);
+        player->setY(s.playerY);
+        player->setVY(0);
+        player->setHasKey(s.playerHasKey);
+        applyBound(player);
+
+        stream(s.playerX, s.playerY, true);
+    }
+
+    //Whether a sound made at (sx, sy) reaches (lx, ly) around the level's walls, for AI hearing
+    bool audibleAt(double sx, double sy, double lx, double ly){
+        if(acoustics == NULL) return true;
+        return acoustics->audibleAt(sx, sy, lx, ly);
+    }
+
+    void updateNpcs(double dt, Player *player){
+        PROFILE_SCOPE("Map::updateNpcs");
+        ALLOC_SCOPE(ALLOC_ENTITIES);
+
+        SDL_Rect *p = player->getDest();
+        for (auto f:flows) f->setTarget(p->x, p->y, p->w, p->h);
+
+        npcs.update(dt, player->getX(), player->getY(), grid);
+
+        //An NPC touching the player is killed, swap-remove leaves the rest of the store untouched
+        for (int i=npcs.findTouching(player->getDest()); i>=0; i=npcs.findTouching(player->getDest(), i)){
+            SDL_Rect dest = npcs.getDest(i);
+            waves->createWave(npcs.getArchetype(i)->clap, dest.x+dest.w/2, dest.y+dest.h/2);
+
+            npcs.removeAt(i);
+        }
+    }
+
+    void updateKey(double dt, Player *player){
+        keys.update(dt, player->getX(), player->getY(), grid);
+
+        for (int i=keys.findTouching(player->getDest()); i>=0; i=keys.findTouching(player->getDest(), i)){
+            player->collectedKey();
+            keys.removeAt(i);
+        }
+    }
+
+    //Strikes are a Poisson process, on average interval s apart, each followed by thunder thunderDelay s later
+    void scheduleLightning(){
+        double u = (lightningRng.range(1000000)+1)/1000001.0;
+
+        timers.schedule(-log(u)*lightning->getInterval(), [this]{
+            lightning->flash(timers.now(), lightningRng.range(300)+100);
+            timers.schedule(lightning->getThunderDelay(), [this]{ lightning->thunder(tiles); });
+
+            scheduleLightning();
+        });
     }
 
     void update(double dt, Player *player){
-        bool hasCollision = false;
+        stream(player->getX(), player->getY());
+
+        if(acoustics){
+            SDL_Rect *p = player->getDest();
+            acoustics->setListener(p->x+p->w/2, p->y+p->h/2);
+        }
+
         waves->updateWaves(dt);
         
         updateNpcs(dt, player);
         updateKey(dt, player);
 
-        if (rand()%1001==0){
-            lightning->update(dt,tiles,true,rand()%300+100);
-        } else lightning->update(dt,tiles);
+        timers.advance(dt);
 
-        for (auto &t:tiles){
-            t->update(dt);
-            hasCollision = waves->collideSound(t);
-            if(hasCollision){
-                t->collide(t->getDest());
-                hasCollision = false;
-            }
+        waves->collideGrid(grid);
+
+        player->collisions(grid);
+    }
+
+    unsigned long long stateHash(unsigned long long h){
+        for (int i=0; i<npcs.size(); i++){
+            h = hashMix(h, npcs.getX(i));
+            h = hashMix(h, npcs.getY(i));
         }
-        player->collisions(tiles);
+        h = hashMix(h, keys.size());
+        h = hashMix(h, lightningRng.getState());
+
+        return h;
     }
 
-    void render(Player *player){
-        waves->renderWaves();
+    //Only the grid cells under the camera are visited, so the cost follows the window rather than the level
+    void render(DrawList &frame, Player *player, Camera *camera){
+        PROFILE_SCOPE("Map::render");
+        ALLOC_SCOPE(ALLOC_FRAME);
+
+        waves->renderWaves(frame, camera);
 
-        for (auto t:tiles) t->render();
+        SDL_Rect view = camera->view();
+        int c0 = max(0, grid.colOf(view.x)), c1 = min(grid.getCols()-1, grid.colOf(view.x+view.w-1));
+        int r0 = max(0, grid.rowOf(view.y)), r1 = min(grid.getRows()-1, grid.rowOf(view.y+view.h-1));
 
-        player->render();
-        lightning->render();
+        for (int r=r0; r<=r1; r++){
+            for (int c=c0; c<=c1; c++){
+                Tile *t = grid.at(c, r);
+                if(t == NULL) continue;
 
-        for (auto e:npcs) e->render();
-        for (auto k:keys) k->render();
+                //A tile covering several cells is drawn once, from the first of them in view
+                if(c != max(c0, grid.colOf(t->getX())) || r != max(r0, grid.rowOf(t->getY()))) continue;
+
+                t->render(frame, camera);
+            }
+        }
+
+        player->render(frame, camera);
+        lightning->render(frame, timers.now());
+
+        npcs.render(frame, camera);
+        keys.render(frame, camera);
     }
   
     ~Map(){
-        while (npcs.size()>0) npcs.erase(npcs.begin());
-        while (tiles.size()>0) tiles.erase(tiles.begin());
+        delete streamer;
+
+        for (auto t:tiles) delete t;
+        for (auto f:flows) delete f;
+        if(waves->getListener() == acoustics) waves->setListener(NULL);
+        delete acoustics;
+        delete lightning;
+
+        for (int i=0; i<TILE_TYPE_COUNT; i++){
+            delete entityTypes[i];
+            delete entityConfs[i];
+        }
+        delete tileKind;
+        delete tileConf;
+        delete lightningConf;
 
         waves->deleteWaves();
     }
@@ -1,60 +1,168 @@
 #pragma once
 
+#include <vector>
+#include <fstream>
+
+#include "AllocTracker.hpp"
+#include "Names.hpp"
+
 using namespace std;
 
+//One animation file, parsed once and shared by every Animation playing it, so reloading it in place updates them all
+struct AnimationSheet{
+	string sheetName;
+	SDL_Texture *texture;
+	vector<SDL_Rect> frames;
+	vector<int> millis; //how long each frame shows
+	int totalTime;
+};
+
+struct LoadedImage{
+	bool loaded;
+	SDL_Texture *texture; //NULL when headless
+	SDL_Point size;
+};
+
+//Media is kept by the interned name it was asked for, the path is only built to read a file the first time
 class MediaManager{
-	map<string,SDL_Texture *> images;
-	map<string,Mix_Chunk *> samples;
+	NameTable<LoadedImage> images;
+	NameTable<Mix_Chunk *> samples;
+	NameTable<AnimationSheet *> animations;
 	SDL_Renderer *ren;
 
+	//Headless managers have no renderer or audio device. Images only keep their size and sounds are never decoded
+	bool headless;
+
 	public:
-	MediaManager(SDL_Renderer *newRen){
+	MediaManager(SDL_Renderer *newRen, bool newHeadless=false){
 		ren = newRen;
+		headless = newHeadless;
 	}
 
-    Mix_Chunk *readSound(string filename){
-		//Sound files are assumed to be in .wav format
-		//This logic can be modified to auto detect filetype in the future
-		filename = "media/sounds/" + filename + ".wav";
+	bool isHeadless(){ return headless; }
 
-		if (samples.find(filename)==samples.end()){
+    Mix_Chunk *readSound(string name){
+		ALLOC_SCOPE(ALLOC_MEDIA);
+
+		if(headless) return NULL;
+
+		int id = Names::get().id(name);
+
+		if (!samples.has(id)){
+			//Sound files are assumed to be in .wav format
+			//This logic can be modified to auto detect filetype in the future
+			string filename = "media/sounds/" + name + ".wav";
 			Mix_Chunk *sample;
 
 			sample = Mix_LoadWAV(filename.c_str());
 
 			if(!sample) throw Exception ("Mix_LoadWAV: " + filename);
-				samples[filename] = sample;
+				samples.set(id, sample);
 		}
 
-		return samples[filename];
+		return samples[id];
+	}
+
+	//All sound playback goes through here so a headless game never touches the mixer.
+	//volume runs from 0 to 1 and is set on every play since channels are reused
+	int playSound(Mix_Chunk *sound, int loops=0, double volume=1.0){
+		if(headless || sound == NULL || volume <= 0) return -1;
+
+		int channel = Mix_PlayChannel(-1, sound, loops);
+		if(channel >= 0) Mix_Volume(channel, (int)(min(volume, 1.0)*MIX_MAX_VOLUME));
+
+		return channel;
 	}
 
-	SDL_Texture *readImage(string filename){
-		SDL_Texture *tex;
+	SDL_Texture *readImage(string name){
+		ALLOC_SCOPE(ALLOC_MEDIA);
+		SDL_Texture *tex = NULL;
 
-		filename = "media/images/" + filename + ".bmp";
+		int id = Names::get().id(name);
 
-		if(images.find(filename)==images.end()){
+		if(!images[id].loaded){
+			string filename = "media/images/" + name + ".bmp";
 			SDL_Surface *ob;
-			
+
 			ob = SDL_LoadBMP(filename.c_str());
 			if (ob == NULL) throw Exception("Could not load "+filename);
-			
-			SDL_SetColorKey(ob, SDL_TRUE, SDL_MapRGB(ob->format, 0, 255, 0));
-			
-			tex = SDL_CreateTextureFromSurface(ren,ob);
-			if (tex == NULL) throw Exception("Could not create texture");
-			
+
+			SDL_Point size = {ob->w, ob->h};
+
+			if(!headless){
+				SDL_SetColorKey(ob, SDL_TRUE, SDL_MapRGB(ob->format, 0, 255, 0));
+
+				tex = SDL_CreateTextureFromSurface(ren,ob);
+				if (tex == NULL) throw Exception("Could not create texture");
+			}
+
 			SDL_FreeSurface(ob);
-			
-			images[filename] = tex;
+
+			images.set(id, {true, tex, size});
 		}
-		
-		return images[filename];
+
+		return images[id].texture;
+	}
+
+	//media/animations/<name>.txt is a frame count and sheet name, then millis x y w h for each frame
+	AnimationSheet parseAnimation(string name){
+		string filename = "media/animations/" + name + ".txt";
+		ifstream in(filename);
+
+		AnimationSheet sheet;
+		int count = 0;
+		in >> count >> sheet.sheetName;
+		if(!in || count <= 0) throw Exception("Could not read animation " + filename);
+
+		//Headless media hands back no texture, the frames are still read so sizes and timing work
+		sheet.texture = readImage(sheet.sheetName);
+		sheet.totalTime = 0;
+
+		for(int i=0; i<count; i++){
+			int millis;
+			SDL_Rect r;
+			in >> millis >> r.x >> r.y >> r.w >> r.h;
+			if(!in) throw Exception("Animation " + filename + " ends before frame " + to_string(i));
+
+			sheet.frames.push_back(r);
+			sheet.millis.push_back(millis);
+			sheet.totalTime += millis;
+		}
+
+		if(sheet.totalTime <= 0) throw Exception("Animation " + filename + " has no length");
+
+		return sheet;
+	}
+
+	AnimationSheet *readAnimation(string name){
+		ALLOC_SCOPE(ALLOC_ANIMATION);
+
+		int id = Names::get().id(name);
+		if(!animations.has(id)) animations.set(id, new AnimationSheet(parseAnimation(name)));
+
+		return animations[id];
+	}
+
+	//Re-reads an animation already in use. A file that fails to parse leaves the old frames playing
+	bool reloadAnimation(string name){
+		ALLOC_SCOPE(ALLOC_ANIMATION);
+
+		int id = Names::get().id(name);
+		if(!animations.has(id)) return false;
+
+		*animations[id] = parseAnimation(name);
+		return true;
+	}
+
+	SDL_Point getImageSize(string name){
+		readImage(name);
+
+		return images[Names::get().id(name)].size;
 	}
 
 	~MediaManager(){
-		for(auto i:images)	SDL_DestroyTexture(i.second);
-	    for(auto i:samples)	Mix_FreeChunk(i.second);
+		for(auto i:images.all())	if(i.texture) SDL_DestroyTexture(i.texture);
+	    for(auto i:samples.all())	if(i) Mix_FreeChunk(i);
+		for(auto i:animations.all()) delete i;
 	}
-};
\ No newline at end of file
+};
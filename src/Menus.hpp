@@ -1,3 +1,4 @@
+
 #include <iostream>
 #include <SDL.h>
 #include <SDL_mixer.h>
@@ -8,6 +9,86 @@
 #include <string>
 #include <SDL_mutex.h>
 
+#include "TextRenderer.hpp"
+
+struct MenuButton{
+	string label;
+	SDL_Rect rect;
+	bool clickable;
+};
+
+//Text drawn on the menu that is not a button
+struct MenuLabel{
+	string text;
+	int x, y;
+};
+
+int menuButtonAt(vector<MenuButton> &buttons, int x, int y){
+	for(int i=0; i<(int)buttons.size(); i++){
+		SDL_Rect &r = buttons[i].rect;
+		if(x > r.x && y > r.y && x < r.x+r.w && y < r.y+r.h) return i;
+	}
+
+	return -1;
+}
+
+//Waits for input and redraws only when the hovered button changes or the window needs repainting.
+//Mouse events for other windows are ignored. Returns the clickable button that was clicked, or -1 when the window is closed
+int runMenu(SDL_Window *window, SDL_Renderer *ren, TextRenderer &text, vector<MenuButton> &buttons, vector<MenuLabel> &labels){
+	Uint32 windowID = SDL_GetWindowID(window);
+
+	SDL_Color black = {0, 0, 0, 255};
+	SDL_Color white = { 225, 255, 255, 255};
+
+	int hovered = -1;
+	bool redraw = true;
+
+	while (true){
+		if(redraw){
+			// make black background
+			SDL_SetRenderDrawColor(ren, black.r, black.g, black.b, black.a);
+			SDL_RenderClear(ren);
+
+			// the hovered button is black text on a white box
+			for(int i=0; i<(int)buttons.size(); i++){
+				if(i == hovered){
+					SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
+					SDL_RenderFillRect(ren, &buttons[i].rect);
+				}
+
+				text.draw(buttons[i].label, buttons[i].rect.x, buttons[i].rect.y, i == hovered ? black : white);
+			}
+
+			for(auto &l:labels) text.draw(l.text, l.x, l.y, white);
+
+			SDL_RenderPresent(ren);
+			redraw = false;
+		}
+
+        SDL_Event e;
+		if(!SDL_WaitEvent(&e)) continue;
+
+		if(e.type == SDL_QUIT){
+			//Put back so a game under the menu sees it too
+			SDL_PushEvent(&e);
+			return -1;
+		} else if(e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_CLOSE && e.window.windowID == windowID){
+			return -1;
+		} else if(e.type == SDL_MOUSEMOTION && e.motion.windowID == windowID){
+			int over = menuButtonAt(buttons, e.motion.x, e.motion.y);
+			if(over != hovered){
+				hovered = over;
+				redraw = true;
+			}
+		} else if(e.type == SDL_MOUSEBUTTONDOWN && e.button.windowID == windowID){
+			int clicked = menuButtonAt(buttons, e.button.x, e.button.y);
+			if(clicked >= 0 && buttons[clicked].clickable) return clicked;
+		} else if(e.type == SDL_WINDOWEVENT){
+			redraw = true;
+		}
+	}
+}
+
 int mainMenu(){
 	SDL_Window *window;                    // Declare a pointer
 
@@ -36,157 +117,28 @@ int mainMenu(){
 
 	SDL_Renderer *ren = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
 
-	SDL_Color black = {0, 0, 0, 255};
-	SDL_Color white = { 225, 255, 255, 255};
-	SDL_Color grey = {120, 120, 120, 255};
-
-	TTF_Font *AovelSansRounded = TTF_OpenFont("media/fonts/aovel-sans-rounded-font/AovelSansRounded-rdDL.ttf", 25);
-	
-	SDL_Surface *startButtonSurface = TTF_RenderText_Solid(AovelSansRounded, "Start Game", white);
-	SDL_Texture *startButtonTexture = SDL_CreateTextureFromSurface(ren, startButtonSurface);
-
-	SDL_Surface *l2ButtonSurface = TTF_RenderText_Solid(AovelSansRounded, "Level Two", white);
-	SDL_Texture *l2ButtonTexture = SDL_CreateTextureFromSurface(ren, l2ButtonSurface);
-
-	SDL_Surface *l3ButtonSurface = TTF_RenderText_Solid(AovelSansRounded, "Level Two", white);
-	SDL_Texture *l3ButtonTexture = SDL_CreateTextureFromSurface(ren, l3ButtonSurface);
-
-	SDL_Surface *instructionsSurface = TTF_RenderText_Solid(AovelSansRounded, "Find the key and unlock the door to escape.", white);
-	SDL_Texture *instructionsTexture = SDL_CreateTextureFromSurface(ren, instructionsSurface);
-
-	int startTextW = 0;
-	int startTextH = 0;
-	int l2TextW = 0;
-	int l2TextH = 0;
-	int l3TextW = 0;
-	int l3TextH = 0;
-	int instructionsTextW = 0;
-	int instructionsTextH = 0;
-
-	SDL_QueryTexture(startButtonTexture, NULL, NULL, &startTextW, &startTextH);
-	SDL_QueryTexture(l2ButtonTexture, NULL, NULL, &l2TextW, &l2TextH);
-	SDL_QueryTexture(l3ButtonTexture, NULL, NULL, &l3TextW, &l3TextH);
-	SDL_QueryTexture(instructionsTexture, NULL, NULL, &instructionsTextW, &instructionsTextH);
-
-	SDL_Rect startDestRect = {w/2 - startTextW/2, h/2 - startTextH/2, startTextW, startTextH};
-	SDL_Rect l2DestRect = {w/2 + l2TextW, h/2 - l2TextH/2, l2TextW, l2TextH};
-	SDL_Rect l3DestRect = {w/2 - 2*l3TextW, h/2 - l3TextH/2, l3TextW, l3TextH};
-	SDL_Rect instructionsDestRect = {w/2 - instructionsTextW/2, h/2 + instructionsTextH * 2, instructionsTextW, instructionsTextH};
-
-	bool done = false;
-
-	while (!done){
-        SDL_Event e;
-		
-		int x, y;
-		Uint32 buttons;
-
-		SDL_PumpEvents();
-
-		buttons = SDL_GetMouseState(&x, &y);
-
-        if(SDL_PollEvent(&e)){
-			if(e.type == SDL_QUIT){ 
-				done = true; 
-				break;
-			} else if(e.type == SDL_MOUSEBUTTONDOWN){
-			 	if (x > w/2 - startTextW/2 && y > h/2 - startTextH/2 && x < w/2 + startTextW/2 && y < h/2 + startTextH/2){	
-					TTF_CloseFont(AovelSansRounded);
-					SDL_DestroyTexture(startButtonTexture);
-					SDL_FreeSurface(startButtonSurface);
+	int clicked;
+	{
+		TextRenderer text(ren);
 
-					SDL_DestroyTexture(l2ButtonTexture);
-					SDL_FreeSurface(l2ButtonSurface);
+		SDL_Point start = text.measure("Start Game");
+		SDL_Point l2 = text.measure("Level Two");
+		SDL_Point l3 = text.measure("Level Three");
+		SDL_Point instructions = text.measure("Find the key and unlock the door to escape.");
 
-					SDL_DestroyTexture(l3ButtonTexture);
-					SDL_FreeSurface(l3ButtonSurface);
+		vector<MenuButton> buttons = {
+			{"Start Game", {w/2 - start.x/2, h/2 - start.y/2, start.x, start.y}, true},
+			{"Level Two", {w/2 + l2.x, h/2 - l2.y/2, l2.x, l2.y}, false},
+			{"Level Three", {w/2 - 2*l3.x, h/2 - l3.y/2, l3.x, l3.y}, false}
+		};
+		vector<MenuLabel> labels = {
+			{"Find the key and unlock the door to escape.", w/2 - instructions.x/2, h/2 + instructions.y * 2}
+		};
 
-					SDL_DestroyTexture(instructionsTexture);
-					SDL_FreeSurface(instructionsSurface);
+		clicked = runMenu(window, ren, text, buttons, labels);
+	}
 
-					// Close and destroy the window
-					SDL_DestroyWindow(window);
-
-					// Clean up
-					TTF_Quit();
-					SDL_Quit();
-					return 1;
-				}
-			}
-		}
-
-		// make black background
-		SDL_SetRenderDrawColor(ren, black.r, black.g, black.b, black.a);
-		SDL_RenderClear(ren);
-	
-		// handle mouseover start button
-		if(x > w/2 - startTextW/2 && y > h/2 - startTextH/2 && x < w/2 + startTextW/2 && y < h/2 + startTextH/2){
-			// set box color white
-			SDL_SetRenderDrawColor(ren, 255,255,255,255);
-			startButtonSurface = TTF_RenderText_Solid(AovelSansRounded, "Start Game", black);
-			startButtonTexture = SDL_CreateTextureFromSurface(ren, startButtonSurface);
-		} else{
-			// set box color black
-			SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-			startButtonSurface = TTF_RenderText_Solid(AovelSansRounded, "Start Game", white);
-			startButtonTexture = SDL_CreateTextureFromSurface(ren, startButtonSurface);
-		}
-
-		SDL_RenderFillRect(ren, &startDestRect);
-		SDL_RenderCopy(ren, startButtonTexture, NULL, &startDestRect);
-
-		// handle mouseover l2 button
-		if(x > w/2 + l2TextW && y > h/2 - l2TextH/2 && x < w/2 + l2TextW*2 && y < h/2 + l2TextH/2){
-			// set box color white
-			SDL_SetRenderDrawColor(ren, 255,255,255,255);
-			l2ButtonSurface = TTF_RenderText_Solid(AovelSansRounded, "Level Two", black);
-			l2ButtonTexture = SDL_CreateTextureFromSurface(ren, l2ButtonSurface);
-		} else{
-			// set box color black
-			SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-			l2ButtonSurface = TTF_RenderText_Solid(AovelSansRounded, "Level Two", white);
-			l2ButtonTexture = SDL_CreateTextureFromSurface(ren, l2ButtonSurface);
-		}
-
-		SDL_RenderFillRect(ren, &l2DestRect);
-		SDL_RenderCopy(ren, l2ButtonTexture, NULL, &l2DestRect);
-
-		// handle mouseover l3 button
-		if(x > w/2 - 2*l3TextW && y > h/2 - l3TextH/2  &&  x < w/2 - l3TextW && y < h/2 + l3TextH/2){
-			// set box color white
-			SDL_SetRenderDrawColor(ren, 255,255,255,255);
-			l3ButtonSurface = TTF_RenderText_Solid(AovelSansRounded, "Level Three", black);
-			l3ButtonTexture = SDL_CreateTextureFromSurface(ren, l3ButtonSurface);
-		} else{
-			// set box color black
-			SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-			l3ButtonSurface = TTF_RenderText_Solid(AovelSansRounded, "Level Three", white);
-			l3ButtonTexture = SDL_CreateTextureFromSurface(ren, l3ButtonSurface);
-		}
-
-		SDL_RenderFillRect(ren, &l3DestRect);
-		SDL_RenderCopy(ren, l3ButtonTexture, NULL, &l3DestRect);
-
-		SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-		SDL_RenderFillRect(ren, &instructionsDestRect);
-		SDL_RenderCopy(ren, instructionsTexture, NULL, &instructionsDestRect);
-
-		SDL_RenderPresent(ren);
-    }
-
-	TTF_CloseFont(AovelSansRounded);
-	
-	SDL_DestroyTexture(startButtonTexture);
-	SDL_FreeSurface(startButtonSurface);
-
-	SDL_DestroyTexture(l2ButtonTexture);
-	SDL_FreeSurface(l2ButtonSurface);
-
-	SDL_DestroyTexture(l3ButtonTexture);
-	SDL_FreeSurface(l3ButtonSurface);
-
-	SDL_DestroyTexture(instructionsTexture);
-	SDL_FreeSurface(instructionsSurface);
+	SDL_DestroyRenderer(ren);
 
     // Close and destroy the window
     SDL_DestroyWindow(window);
@@ -194,15 +146,13 @@ int mainMenu(){
     // Clean up
 	TTF_Quit();
     SDL_Quit();
-    return 0;
+    return clicked == 0 ? 1 : 0;
 }
 
+//Opened over a running game, so SDL is already up and is left that way. Returns 1 when Quit Game is clicked
 int pauseMenu(){
 	SDL_Window *window;                    // Declare a pointer
 
-    SDL_Init(SDL_INIT_VIDEO);              // Initialize SDL2
-	TTF_Init();
-
 	int w = 640;
 	int h = 480;
 
@@ -220,95 +170,31 @@ int pauseMenu(){
     if(window == NULL) {
         // In the case that the window could not be made...
         printf("Could not create window: %s\n", SDL_GetError());
-        return 1;
+        return 0;
     }
 
 	SDL_SetWindowInputFocus(window);
 
 	SDL_Renderer *ren = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
 
-	SDL_Color black = {0, 0, 0, 255};
-	SDL_Color white = { 225, 255, 255, 255};
-	SDL_Color grey = {120, 120, 120, 255};
-
-	TTF_Font *AovelSansRounded = TTF_OpenFont("media/fonts/aovel-sans-rounded-font/AovelSansRounded-rdDL.ttf", 25);
-	
-	SDL_Surface *startButtonSurface = TTF_RenderText_Solid(AovelSansRounded, "Quit Game", white);
-	SDL_Texture *startButtonTexture = SDL_CreateTextureFromSurface(ren, startButtonSurface);
-
-	int startTextW = 0;
-	int startTextH = 0;
-
-	SDL_QueryTexture(startButtonTexture, NULL, NULL, &startTextW, &startTextH);
-
-	SDL_Rect startDestRect = {w/2 - startTextW/2, h/2 - startTextH/2, startTextW, startTextH};
-
-	bool done = false;
-
-	while (!done){
-        SDL_Event e;
-		
-		int x, y;
-		Uint32 buttons;
-
-		SDL_PumpEvents();
-
-		buttons = SDL_GetMouseState(&x, &y);
-
-        if(SDL_PollEvent(&e)){
-			if(e.type == SDL_QUIT){ 
-				done=true; 
-				break;
-			} else if(e.type == SDL_MOUSEBUTTONDOWN){
-			 	if(x > w/2 - startTextW/2 && y > h/2 - startTextH/2 && x < w/2 + startTextW/2 && y < h/2 + startTextH/2){	
-					TTF_CloseFont(AovelSansRounded);
-					SDL_DestroyTexture(startButtonTexture);
-					SDL_FreeSurface(startButtonSurface);
-
-					// Close and destroy the window
-					SDL_DestroyWindow(window);
-
-					// Clean up
-					TTF_Quit();
-					SDL_Quit();
-					return 1;
-				}
-			}
-		}
+	int clicked;
+	{
+		TextRenderer text(ren);
 
-		// make black background
-		SDL_SetRenderDrawColor(ren, black.r, black.g, black.b, black.a);
-		SDL_RenderClear(ren);
-	
-		// handle mouseover start button
-		if(x > w/2 - startTextW/2 && y > h/2 - startTextH/2 && x < w/2 + startTextW/2 && y < h/2 + startTextH/2){
-			// set box color white
-			SDL_SetRenderDrawColor(ren, 255,255,255,255);
-			startButtonSurface = TTF_RenderText_Solid(AovelSansRounded, "Quit Game", black);
-			startButtonTexture = SDL_CreateTextureFromSurface(ren, startButtonSurface);
-		} else{
-			// set box color black
-			SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-			startButtonSurface = TTF_RenderText_Solid(AovelSansRounded, "Quit Game", white);
-			startButtonTexture = SDL_CreateTextureFromSurface(ren, startButtonSurface);
-		}
+		SDL_Point quit = text.measure("Quit Game");
 
-		SDL_RenderFillRect(ren, &startDestRect);
-		SDL_RenderCopy(ren, startButtonTexture, NULL, &startDestRect);
+		vector<MenuButton> buttons = {
+			{"Quit Game", {w/2 - quit.x/2, h/2 - quit.y/2, quit.x, quit.y}, true}
+		};
+		vector<MenuLabel> labels;
 
-		SDL_RenderPresent(ren);
-    }
+		clicked = runMenu(window, ren, text, buttons, labels);
+	}
 
-	TTF_CloseFont(AovelSansRounded);
-	
-	SDL_DestroyTexture(startButtonTexture);
-	SDL_FreeSurface(startButtonSurface);
+	SDL_DestroyRenderer(ren);
 
     // Close and destroy the window
     SDL_DestroyWindow(window);
 
-    // Clean up
-	TTF_Quit();
-    SDL_Quit();
-    return 0;
-}
\ No newline at end of file
+    return clicked == 0 ? 1 : 0;
+}
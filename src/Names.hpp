@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <SDL_mutex.h>
+
+using namespace std;
+
+//Animation and sound names the code asks for by ID. They always get these IDs, in this order
+enum NameId{NAME_WALK_LEFT, NAME_WALK_RIGHT, NAME_JUMP_LEFT, NAME_JUMP_RIGHT, NAME_FLOOR, NAME_CEILING, NAME_LWALL,
+	NAME_RWALL, NAME_DOOR, NAME_KEY, NAME_THUNDER, NAME_COUNT};
+static const char *nameStrings[NAME_COUNT] = {"walkLeft", "walkRight", "jumpLeft", "jumpRight", "floor", "ceiling", "lWall",
+	"rWall", "door", "key", "thunder"};
+
+//Turns names from configs and level files into small integer IDs once, when content is loaded, so the game loop
+//only ever indexes arrays with them. A name not in NameId gets the next free ID the first time it is seen
+class Names{
+	unordered_map<string,int> ids;
+	deque<string> names; //by ID, a deque so a name handed out by reference never moves
+	SDL_mutex *mutex;
+
+	Names(){
+		mutex = SDL_CreateMutex();
+		for(int i=0; i<NAME_COUNT; i++) id(nameStrings[i]);
+	}
+
+	public:
+	static Names &get(){
+		static Names names;
+		return names;
+	}
+
+	int id(const string &name){
+		SDL_LockMutex(mutex);
+
+		int n;
+		auto found = ids.find(name);
+		if(found != ids.end()) n = found->second;
+		else {
+			n = names.size();
+			ids[name] = n;
+			names.push_back(name);
+		}
+
+		SDL_UnlockMutex(mutex);
+		return n;
+	}
+
+	string name(int n){
+		SDL_LockMutex(mutex);
+		string s = n >= 0 && n < (int)names.size() ? names[n] : "";
+		SDL_UnlockMutex(mutex);
+
+		return s;
+	}
+
+	int size(){
+		SDL_LockMutex(mutex);
+		int n = names.size();
+		SDL_UnlockMutex(mutex);
+
+		return n;
+	}
+};
+
+//Something per interned name, indexed by its ID. Names never set read as T(), NULL for pointers
+template<typename T>
+class NameTable{
+	vector<T> slots;
+
+	public:
+	void set(int id, T value){
+		if(id >= (int)slots.size()) slots.resize(id+1, T());
+		slots[id] = value;
+	}
+
+	T operator[](int id) const{
+		return id >= 0 && id < (int)slots.size() ? slots[id] : T();
+	}
+
+	bool has(int id) const{ return (*this)[id] != T(); }
+
+	//Every slot, set or not, for freeing what they point to
+	const vector<T> &all() const{ return slots; }
+};
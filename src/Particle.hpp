@@ -11,6 +11,7 @@ class Particle{
 	double x, y, vx, vy, ax, ay, v, damp;
 	int minx, miny, maxx, maxy, theta;
 	bool isCartesian;        
+	SDL_Rect box; //filled in by getDest, so asking for it every tick does not allocate
 
 	public:
 	Particle(double newx=0.0, double newy=0.0,
@@ -35,13 +36,27 @@ class Particle{
 		setBound();
 	}
 
-	void setBound(int newMinX=-32, int newMinY=-32, int newMaxX=1312, int newMaxY=752){
+	//Without a bound (the default) a particle is never reflected or clamped. Levels set it from their own size
+	void setBound(int newMinX=0, int newMinY=0, int newMaxX=0, int newMaxY=0){
 		minx=newMinX;
 		miny=newMinY;
 		maxx=newMaxX;
 		maxy=newMaxY;
 	}
 	
+	//Keeps a Cartesian particle inside its bound, without the reflections a polar particle gets
+	void clampToBound(){
+		if(maxx!=minx){
+			if(x<minx) x = minx;
+			if(x>maxx) x = maxx;
+		}
+
+		if(maxy!=miny){
+			if(y<miny) y = miny;
+			if(y>maxy) y = maxy;
+		}
+	}
+
 	void setX(double newX){ x = newX; }
 	double getX(){ return x; }
 
@@ -50,6 +65,8 @@ class Particle{
 
 	double getMaxY(){ return maxy; }
 
+	int getTheta(){ return theta; }
+
 	void setVY(double newVY){ vy = newVY; }
 
 	void updatePolar(double dt){
@@ -71,14 +88,12 @@ class Particle{
 	}
 
 	virtual SDL_Rect *getDest(){ 
-		SDL_Rect *returnVal = new SDL_Rect();
-
-		returnVal->x = x;
-		returnVal->y = y;
-		returnVal->w = 1;
-		returnVal->h = 1;
+		box.x = x;
+		box.y = y;
+		box.w = 1;
+		box.h = 1;
 
-		return returnVal;
+		return &box;
 	}
 	
 	void swap(double &a, double &b){
@@ -147,7 +162,6 @@ class Particle{
 			vy = v*sin(theta*PI/180);
 		}
 
-		delete myBox;
 		return hasCollision;
 	}
 
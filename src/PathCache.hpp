@@ -0,0 +1,171 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <list>
+#include <memory>
+
+using namespace std;
+
+//One straight stretch of a particle's flight, starting at time t (s into the wave) from (x, y)
+struct PathSegment{
+	float t, x, y, vx, vy;
+	int hitCol, hitRow; //tile the particle bounced off to start this stretch, -1 for none
+};
+
+struct PathTrack{
+	float born; //particles added as the wavefront grows start after the wave does
+	float died; //when it was retired, infinite if it outlived the wave
+	int first, count; //its stretches in the path's segments
+};
+
+//Every particle of one wave from its start until it faded, recorded once and replayed by later waves
+//of the same sound from the same place
+struct WavePath{
+	vector<PathTrack> tracks;
+	vector<PathSegment> segments; //every track's stretches, one track after another
+	double duration;
+	double reach; //px from the origin no particle got beyond
+
+	size_t bytes(){
+		return sizeof(WavePath) + tracks.capacity()*sizeof(PathTrack) + segments.capacity()*sizeof(PathSegment);
+	}
+};
+
+struct PathKey{
+	const void *profile;
+	int x, y;
+
+	bool operator<(const PathKey &o) const{
+		if(profile != o.profile) return profile < o.profile;
+		if(x != o.x) return x < o.x;
+		return y < o.y;
+	}
+};
+
+//Recorded wave paths by sound and origin, the least recently used dropped once they take more than capacity bytes.
+//Paths are shared with the waves replaying them, so dropping one never pulls it out from under a live wave
+class PathCache{
+	struct Entry{
+		shared_ptr<WavePath> path;
+		size_t bytes;
+		list<PathKey>::iterator use; //its place in recency
+	};
+
+	//A wave still recording, from (x, y) and so far no further than reach px from there
+	struct Recording{
+		int x, y;
+		double reach;
+		bool stale; //tiles it may have crossed changed, so its path is thrown away
+	};
+
+	map<PathKey, Entry> entries;
+	list<PathKey> recency; //least recently used first
+	size_t capacity, used;
+	map<int, Recording> recordings;
+	int nextRecording;
+	long hits, misses;
+
+	static bool overlaps(int x, int y, double reach, int x0, int y0, int x1, int y1){
+		return x+reach >= x0 && x-reach <= x1 && y+reach >= y0 && y-reach <= y1;
+	}
+
+	void erase(map<PathKey, Entry>::iterator i){
+		used -= i->second.bytes;
+		recency.erase(i->second.use);
+		entries.erase(i);
+	}
+
+	public:
+	PathCache(size_t newCapacity=0){
+		capacity = newCapacity;
+		used = 0;
+		nextRecording = 0;
+		hits = 0;
+		misses = 0;
+	}
+
+	bool isEnabled(){ return capacity > 0; }
+	void setCapacity(size_t newCapacity){
+		capacity = newCapacity;
+		trim();
+	}
+
+	long getHits(){ return hits; }
+	long getMisses(){ return misses; }
+	size_t bytes(){ return used; }
+	int size(){ return entries.size(); }
+
+	shared_ptr<WavePath> find(PathKey key){
+		auto found = entries.find(key);
+		if(found == entries.end()){
+			misses++;
+			return shared_ptr<WavePath>();
+		}
+
+		hits++;
+		recency.splice(recency.end(), recency, found->second.use);
+		return found->second.path;
+	}
+
+	//Starts tracking a recording from (x, y). Returns the ticket its path is inserted with
+	int beginRecording(int x, int y){
+		Recording r = {x, y, 0, false};
+		recordings[++nextRecording] = r;
+
+		return nextRecording;
+	}
+
+	//The recording has got as far as reach px from its origin
+	void reached(int ticket, double reach){
+		auto found = recordings.find(ticket);
+		if(found != recordings.end()) found->second.reach = reach;
+	}
+
+	//A recording that will never be inserted
+	void abandon(int ticket){ recordings.erase(ticket); }
+
+	//Stores the path of the recording with ticket, unless tiles within its reach changed while it was made
+	void insert(PathKey key, shared_ptr<WavePath> path, int ticket){
+		auto recorded = recordings.find(ticket);
+		if(recorded == recordings.end()) return;
+
+		bool stale = recorded->second.stale;
+		recordings.erase(recorded);
+		if(stale || !isEnabled()) return;
+
+		auto found = entries.find(key);
+		if(found != entries.end()) erase(found);
+
+		recency.push_back(key);
+		Entry e = {path, path->bytes(), prev(recency.end())};
+		entries[key] = e;
+		used += e.bytes;
+
+		trim();
+	}
+
+	void trim(){
+		while(used > capacity && !recency.empty()) erase(entries.find(recency.front()));
+	}
+
+	//Drops every path, and spoils every recording, that could have crossed the level pixels x0..x1, y0..y1
+	void invalidate(int x0, int y0, int x1, int y1){
+		for(auto &r:recordings)
+			if(overlaps(r.second.x, r.second.y, r.second.reach, x0, y0, x1, y1)) r.second.stale = true;
+
+		for(auto i=entries.begin(); i!=entries.end();){
+			auto next = std::next(i);
+			if(overlaps(i->first.x, i->first.y, i->second.path->reach, x0, y0, x1, y1)) erase(i);
+			i = next;
+		}
+	}
+
+	void clear(){
+		for(auto &r:recordings) r.second.stale = true;
+
+		entries.clear();
+		recency.clear();
+		used = 0;
+	}
+};
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <atomic>
+#include <stdio.h>
+#include <math.h>
+#include <SDL.h>
+#include <SDL_mutex.h>
+
+#include "TextRenderer.hpp"
+
+using namespace std;
+
+enum ProfileCounter{COUNTER_WAVES, COUNTER_PARTICLES, COUNTER_COLLISION_TESTS, COUNTER_DRAW_CALLS, COUNTER_WAVES_MERGED, COUNTER_PARTICLES_RETIRED, COUNTER_COUNT};
+
+static const char *profileCounterNames[COUNTER_COUNT] = {"waves", "particles", "collisionTests", "drawCalls", "wavesMerged", "particlesRetired"};
+
+struct ProfileEvent{
+	const char *name;
+	Uint64 start, end;
+};
+
+//Everything one thread records. Only its own thread writes to it, so the hot path takes no lock
+struct ProfileTrack{
+	string name;
+	int id;
+
+	vector<ProfileEvent> events;
+	long counters[COUNTER_COUNT];
+	long gauges[COUNTER_COUNT];
+
+	//Per scope totals for the frame in progress and the last finished frame, read by the overlay
+	vector<pair<const char *, Uint64> > frame;
+	vector<pair<const char *, Uint64> > lastFrame;
+	long lastCounters[COUNTER_COUNT];
+
+	//Counter samples for the trace, one per finished frame
+	vector<pair<Uint64, vector<long> > > counterSamples;
+};
+
+//Scoped timers and per-frame counters for the physics and render threads.
+//Disabled scopes cost one branch. Enable with profile=1, export with profileTrace=<file>, F3 toggles the overlay
+class Profiler{
+	vector<ProfileTrack *> tracks;
+	SDL_mutex *mutex;
+
+	atomic<bool> enabled;
+	atomic<bool> overlay;
+	Uint64 origin;
+
+	static const size_t MAX_EVENTS = 1000000; //per track, the overlay keeps working after the trace fills
+
+	Profiler(){
+		mutex = SDL_CreateMutex();
+		enabled = false;
+		overlay = false;
+		origin = SDL_GetPerformanceCounter();
+	}
+
+	ProfileTrack *&threadTrack(){
+		static thread_local ProfileTrack *track = NULL;
+		return track;
+	}
+
+	public:
+	static Profiler &get(){
+		static Profiler profiler;
+		return profiler;
+	}
+
+	bool isEnabled(){ return enabled; }
+	void setEnabled(bool newEnabled){ enabled = newEnabled; }
+
+	bool overlayShown(){ return overlay; }
+	void toggleOverlay(){
+		overlay = !overlay;
+		if(overlay) enabled = true;
+	}
+
+	//Called once at the top of each thread's loop, names the track it records into
+	void nameThread(string name){
+		ProfileTrack *t = track();
+		t->name = name;
+	}
+
+	ProfileTrack *track(){
+		ProfileTrack *&t = threadTrack();
+
+		if(t == NULL){
+			t = new ProfileTrack();
+			t->events.reserve(4096);
+			for(int i=0; i<COUNTER_COUNT; i++){
+				t->counters[i] = 0;
+				t->gauges[i] = -1;
+				t->lastCounters[i] = 0;
+			}
+
+			SDL_LockMutex(mutex);
+			t->id = tracks.size();
+			t->name = "Thread " + to_string(t->id);
+			tracks.push_back(t);
+			SDL_UnlockMutex(mutex);
+		}
+
+		return t;
+	}
+
+	void record(const char *name, Uint64 start, Uint64 end){
+		ProfileTrack *t = track();
+
+		if(t->events.size() < MAX_EVENTS) t->events.push_back({name, start, end});
+
+		for(auto &f:t->frame){
+			if(f.first == name){
+				f.second += end-start;
+				return;
+			}
+		}
+		t->frame.push_back(make_pair(name, end-start));
+	}
+
+	//Counters accumulate over a frame, gauges hold the latest value
+	void count(ProfileCounter counter, long n){
+		if(enabled) track()->counters[counter] += n;
+	}
+
+	void gauge(ProfileCounter counter, long value){
+		if(enabled) track()->gauges[counter] = value;
+	}
+
+	//Closes the calling thread's frame, publishing its totals to the overlay and its counters to the trace
+	void endFrame(){
+		if(!enabled) return;
+
+		ProfileTrack *t = track();
+		vector<long> sample(COUNTER_COUNT);
+
+		SDL_LockMutex(mutex);
+		t->lastFrame = t->frame;
+		for(int i=0; i<COUNTER_COUNT; i++){
+			t->lastCounters[i] = t->gauges[i] >= 0 ? t->gauges[i] : t->counters[i];
+			sample[i] = t->lastCounters[i];
+		}
+		SDL_UnlockMutex(mutex);
+
+		if(t->counterSamples.size() < MAX_EVENTS) t->counterSamples.push_back(make_pair(SDL_GetPerformanceCounter(), sample));
+
+		for(auto &f:t->frame) f.second = 0;
+		for(int i=0; i<COUNTER_COUNT; i++) t->counters[i] = 0;
+	}
+
+	double micros(Uint64 counter){
+		return double(counter-origin)*1000000.0/SDL_GetPerformanceFrequency();
+	}
+
+	//Draws one row of bars per track, one bar per scope, 1 ms = 40 px, followed by counter bars on a log scale.
+	//With a text renderer each track is named and every bar gets a line in a legend below it
+	void renderOverlay(SDL_Renderer *ren, TextRenderer *text=NULL){
+		if(!overlay) return;
+
+		double msPerCounter = 1000.0/SDL_GetPerformanceFrequency();
+		int y = 8;
+		char line[128];
+		SDL_Color white = {255, 255, 255, 230};
+
+		SDL_LockMutex(mutex);
+		for(auto t:tracks){
+			int x = 8;
+			int colorIndex = 0;
+
+			if(text){
+				text->draw(t->name, 8, y, white);
+				y += text->getLineHeight();
+			}
+
+			for(auto &f:t->lastFrame){
+				SDL_Rect bar = {x, y, (int)(f.second*msPerCounter*40), 10};
+
+				SDL_SetRenderDrawColor(ren, 80+(colorIndex*67)%176, 80+(colorIndex*131)%176, 80+(colorIndex*29)%176, 200);
+				SDL_RenderFillRect(ren, &bar);
+
+				x += bar.w + 1;
+				colorIndex++;
+			}
+
+			y += 14;
+
+			if(text){
+				colorIndex = 0;
+
+				for(auto &f:t->lastFrame){
+					SDL_Rect swatch = {8, y+2, 8, 8};
+					SDL_SetRenderDrawColor(ren, 80+(colorIndex*67)%176, 80+(colorIndex*131)%176, 80+(colorIndex*29)%176, 200);
+					SDL_RenderFillRect(ren, &swatch);
+
+					snprintf(line, sizeof(line), "%s %.2f ms", f.first, f.second*msPerCounter);
+					text->draw(line, 20, y, white);
+
+					y += text->getLineHeight();
+					colorIndex++;
+				}
+			}
+
+			for(int i=0; i<COUNTER_COUNT; i++){
+				if(t->lastCounters[i] <= 0) continue;
+
+				SDL_Rect bar = {8, y, (int)(log10((double)t->lastCounters[i]+1)*60), 4};
+				SDL_SetRenderDrawColor(ren, 255, 200-i*50, 60, 200);
+				SDL_RenderFillRect(ren, &bar);
+
+				if(text){
+					snprintf(line, sizeof(line), "%s %ld", profileCounterNames[i], t->lastCounters[i]);
+					text->draw(line, bar.x+bar.w+6, y-text->getLineHeight()/2+2, white);
+					y += text->getLineHeight()-6;
+				}
+
+				y += 6;
+			}
+
+			y += 6;
+		}
+		SDL_UnlockMutex(mutex);
+
+		SDL_SetRenderDrawColor(ren, 0x00, 0x00, 0x00, 0xFF);
+	}
+
+	//Chrome trace-event JSON (chrome://tracing or ui.perfetto.dev). Call once the threads have stopped
+	void writeTrace(string filename){
+		ofstream out(filename);
+		if(!out) throw Exception("Could not open trace file " + filename);
+
+		out << "{\"traceEvents\":[\n";
+
+		bool first = true;
+		for(auto t:tracks){
+			out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t->id
+				<< ",\"args\":{\"name\":\"" << t->name << "\"}}";
+			first = false;
+
+			for(auto &e:t->events){
+				out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << t->id
+					<< ",\"ts\":" << micros(e.start) << ",\"dur\":" << micros(e.end)-micros(e.start) << "}";
+			}
+
+			for(auto &s:t->counterSamples){
+				out << ",\n{\"name\":\"" << t->name << " counters\",\"ph\":\"C\",\"pid\":1,\"tid\":" << t->id
+					<< ",\"ts\":" << micros(s.first) << ",\"args\":{";
+
+				bool firstArg = true;
+				for(int i=0; i<COUNTER_COUNT; i++){
+					if(s.second[i] == 0) continue;
+
+					out << (firstArg ? "" : ",") << "\"" << profileCounterNames[i] << "\":" << s.second[i];
+					firstArg = false;
+				}
+				out << "}}";
+			}
+		}
+
+		out << "\n]}\n";
+	}
+};
+
+class ProfileScope{
+	const char *name;
+	Uint64 start;
+
+	public:
+	ProfileScope(const char *newName){
+		name = NULL;
+
+		if(Profiler::get().isEnabled()){
+			name = newName;
+			start = SDL_GetPerformanceCounter();
+		}
+	}
+
+	~ProfileScope(){
+		if(name) Profiler::get().record(name, start, SDL_GetPerformanceCounter());
+	}
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+//Small seeded generator (splitmix64) so each subsystem owns its own stream instead of sharing rand().
+//Two generators built from the same seed and stream name always produce the same sequence.
+class Random{
+	unsigned long long state;
+
+	public:
+	Random(unsigned long long newSeed=0, string stream=""){
+		seed(newSeed, stream);
+	}
+
+	void seed(unsigned long long newSeed, string stream=""){
+		//FNV-1a of the stream name keeps subsystems sharing a seed independent of each other
+		unsigned long long h = 14695981039346656037ULL;
+		for(char c:stream){
+			h ^= (unsigned char)c;
+			h *= 1099511628211ULL;
+		}
+
+		state = newSeed ^ h;
+	}
+
+	unsigned long long next(){
+		unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	//Uniform-enough integer in [0, n)
+	int range(int n){ return (int)(next() % (unsigned long long)n); }
+
+	unsigned long long getState(){ return state; }
+	void setState(unsigned long long newState){ state = newState; }
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstring>
+
+using namespace std;
+
+//Records or plays back everything that makes a session non-deterministic: the seed, the dt of
+//every physics tick and the input applied at the start of each tick.
+//The log is plain text, one record per line:
+//  seed <n>           first line, the seed every subsystem generator is derived from
+//  key <down|up> <n>  an input applied before the next tick
+//  tick <dt>          one physics tick, dt written with enough digits to round trip exactly
+//  hash <tick> <n>    a state checksum, compared on playback to prove the replay did not diverge
+class Replay{
+	ofstream out;
+	ifstream in;
+
+	bool recording;
+	bool playing;
+	unsigned long long seed;
+
+	bool diverged;
+	int hashesChecked;
+
+	public:
+	static const int HASH_INTERVAL = 100;
+
+	Replay(){
+		recording = false;
+		playing = false;
+		seed = 0;
+		diverged = false;
+		hashesChecked = 0;
+	}
+
+	bool isRecording(){ return recording; }
+	bool isPlaying(){ return playing; }
+	unsigned long long getSeed(){ return seed; }
+
+	void record(string filename, unsigned long long newSeed){
+		out.open(filename);
+		if(!out) throw Exception("Could not open replay file " + filename + " for writing");
+
+		seed = newSeed;
+		recording = true;
+
+		out << "seed " << seed << "\n";
+	}
+
+	void play(string filename){
+		in.open(filename);
+		if(!in) throw Exception("Could not open replay file " + filename);
+
+		string tag;
+		in >> tag >> seed;
+		if(tag != "seed") throw Exception("Replay file " + filename + " does not start with a seed");
+
+		playing = true;
+	}
+
+	void recordInput(SDL_Event &e){
+		if(!recording) return;
+
+		out << "key " << (e.type==SDL_KEYDOWN ? "down " : "up ") << e.key.keysym.sym << "\n";
+	}
+
+	void recordTick(double dt){
+		if(!recording) return;
+
+		out << "tick " << setprecision(17) << dt << "\n";
+	}
+
+	//Reads the inputs for the next tick and its dt. Returns false once the log is exhausted
+	bool nextTick(vector<SDL_Event> &inputs, double &dt){
+		string tag;
+
+		while(in >> tag){
+			if(tag == "key"){
+				string state;
+				int sym;
+				in >> state >> sym;
+
+				SDL_Event e;
+				memset(&e, 0, sizeof(e));
+				e.type = state=="down" ? SDL_KEYDOWN : SDL_KEYUP;
+				e.key.keysym.sym = sym;
+
+				inputs.push_back(e);
+			} else if(tag == "tick"){
+				in >> dt;
+				return true;
+			} else if(tag == "hash"){
+				string skip;
+				getline(in, skip);
+			}
+		}
+
+		playing = false;
+		return false;
+	}
+
+	//Called after every tick. Recording writes a checksum every HASH_INTERVAL ticks, playback compares it
+	void checkpoint(int tick, unsigned long long hash){
+		if(tick % HASH_INTERVAL != 0) return;
+
+		if(recording){
+			out << "hash " << tick << " " << hash << "\n";
+		} else if(playing){
+			streampos start = in.tellg();
+			string tag;
+			int recordedTick;
+			unsigned long long recordedHash;
+
+			if(in >> tag && tag == "hash" && in >> recordedTick >> recordedHash && recordedTick == tick){
+				hashesChecked++;
+
+				if(hash != recordedHash && !diverged){
+					diverged = true;
+					cerr << "Replay diverged at tick " << tick << endl;
+				}
+			} else {
+				in.clear();
+				in.seekg(start);
+			}
+		}
+	}
+
+	void report(){
+		if(hashesChecked > 0 && !diverged)
+			cout << "Replay matched " << hashesChecked << " checksums" << endl;
+	}
+
+	bool hasDiverged(){ return diverged; }
+
+	~Replay(){
+		if(recording) out.close();
+	}
+};
+
+//FNV-1a over the raw bytes of a value, used to build the state checksums above
+template<typename T>
+unsigned long long hashMix(unsigned long long h, T value){
+	unsigned char bytes[sizeof(T)];
+	memcpy(bytes, &value, sizeof(T));
+
+	for(unsigned i=0; i<sizeof(T); i++){
+		h ^= bytes[i];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <SDL.h>
+#include <SDL_mixer.h>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Exception.hpp"
+#include "Config.hpp"
+#include "Random.hpp"
+
+//Tick times are binned to this many ms for the percentiles, up to SOAK_BINS of them
+#define SOAK_BIN_MS 0.05
+#define SOAK_BINS 10000
+
+using namespace std;
+
+//A scripted wave storm. For soakSeconds of game time waves are started soakRate times a second at random spots
+//around the camera while the level plays as usual, and what every tick cost is logged to soakReport as CSV.
+//The run fails if the p99 tick takes longer than soakBudgetMs or the second half of the run grows the resident
+//set by more than soakGrowthKB over the first. Enable with soakRate=<waves/s>
+class SoakTest{
+	bool enabled;
+	double rate, duration, budgetMs;
+	long growthKB;
+	string csvFile;
+	ofstream csv;
+
+	Random rng;
+	double elapsed, owed;
+	long spawned;
+
+	int waves, peakWaves;
+	long particles, peakParticles;
+	int peakChannels;
+	atomic<double> drawMs; //last frame drawn by the render thread, it never waits on the physics thread for it
+
+	//Fixed up front so the test does not grow the heap it is watching
+	vector<long> bins;
+	long ticks;
+	double maxMs;
+	long firstHalfKB, secondHalfKB; //largest resident set seen in each half
+
+	//Resident set in KB, 0 where it cannot be read
+	static long residentKB(){
+#ifdef __APPLE__
+		mach_task_basic_info info;
+		mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+		if(task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS)
+			return info.resident_size/1024;
+		return 0;
+#else
+		ifstream statm("/proc/self/statm");
+		long size = 0, resident = 0;
+		if(!(statm >> size >> resident)) return 0;
+		return resident*(sysconf(_SC_PAGESIZE)/1024);
+#endif
+	}
+
+	double percentile(double p){
+		long n = (long)(p*ticks), seen = 0;
+
+		for(int i=0; i<SOAK_BINS; i++){
+			seen += bins[i];
+			if(seen > n) return (i+1)*SOAK_BIN_MS;
+		}
+
+		return maxMs;
+	}
+
+	public:
+	SoakTest(){
+		enabled = false;
+		drawMs = 0;
+	}
+
+	void configure(Config &conf, unsigned long long seed){
+		rate = stod(conf["soakRate"]);
+		enabled = rate > 0;
+		if(!enabled) return;
+
+		duration = stod(conf["soakSeconds"]);
+		budgetMs = stod(conf["soakBudgetMs"]);
+		growthKB = stol(conf["soakGrowthKB"]);
+		csvFile = conf["soakReport"];
+
+		rng.seed(seed, "soak");
+		elapsed = 0;
+		owed = 0;
+		spawned = 0;
+		waves = peakWaves = 0;
+		particles = peakParticles = 0;
+		peakChannels = 0;
+
+		bins.assign(SOAK_BINS, 0);
+		ticks = 0;
+		maxMs = 0;
+		firstHalfKB = secondHalfKB = 0;
+
+		if(csvFile != ""){
+			csv.open(csvFile);
+			if(!csv) throw Exception("Could not open soak report " + csvFile);
+			csv << "tick,seconds,update_ms,frame_ms,draw_ms,waves,particles,rss_kb,channels\n";
+		}
+	}
+
+	bool isEnabled(){ return enabled; }
+	bool isFinished(){ return enabled && elapsed >= duration-1e-9; }
+
+	//How many waves to start this tick, carrying the fraction over so any rate comes out right on average
+	int due(double dt){
+		elapsed += dt;
+		owed += rate*dt;
+
+		int n = (int)(owed+1e-9);
+		owed -= n;
+		spawned += n;
+
+		return n;
+	}
+
+	int range(int n){ return n > 0 ? rng.range(n) : 0; }
+
+	//Live waves and particles once the tick has updated them
+	void setLoad(int newWaves, long newParticles){
+		waves = newWaves;
+		particles = newParticles;
+		peakWaves = max(peakWaves, waves);
+		peakParticles = max(peakParticles, particles);
+	}
+
+	//Render thread, after each present
+	void drawn(double ms){ drawMs = ms; }
+
+	//Physics thread, at the end of each tick
+	void sample(int tick, double updateMs, double frameMs){
+		if(!enabled) return;
+
+		double ms = updateMs + frameMs;
+		bins[min(SOAK_BINS-1, (int)(ms/SOAK_BIN_MS))]++;
+		ticks++;
+		maxMs = max(maxMs, ms);
+
+		long rss = residentKB();
+		if(elapsed < duration/2) firstHalfKB = max(firstHalfKB, rss);
+		else secondHalfKB = max(secondHalfKB, rss);
+
+		//The mixer is never opened headless
+		int channels = SDL_WasInit(SDL_INIT_AUDIO) ? Mix_Playing(-1) : 0;
+		peakChannels = max(peakChannels, channels);
+
+		if(csv.is_open()){
+			csv << tick << ',' << elapsed << ',' << updateMs << ',' << frameMs << ',' << drawMs.load() << ',' << waves << ','
+				<< particles << ',' << rss << ',' << channels << '\n';
+		}
+	}
+
+	//Prints the summary and says whether the run stayed within its budgets
+	bool report(ostream &out){
+		if(!enabled) return true;
+		if(csv.is_open()) csv.flush();
+
+		double p99 = percentile(0.99);
+		long growth = secondHalfKB > 0 ? secondHalfKB-firstHalfKB : 0;
+		bool slow = p99 > budgetMs, leaking = growth > growthKB;
+
+		out << "Soak: " << spawned << " waves in " << elapsed << "s over " << ticks << " ticks" << endl;
+		out << "Soak: update+frame p50 " << percentile(0.5) << " ms p99 " << p99 << " ms max " << maxMs << " ms, budget "
+			<< budgetMs << " ms" << endl;
+		out << "Soak: peak " << peakWaves << " waves, " << peakParticles << " particles, " << peakChannels << " channels" << endl;
+		out << "Soak: resident " << firstHalfKB << " KB in the first half, " << secondHalfKB << " KB in the second, limit +"
+			<< growthKB << " KB" << endl;
+
+		if(slow) out << "Soak: FAILED, p99 tick over budget" << endl;
+		if(leaking) out << "Soak: FAILED, memory grew by " << growth << " KB" << endl;
+		if(!slow && !leaking) out << "Soak: passed" << endl;
+
+		return !slow && !leaking;
+	}
+};
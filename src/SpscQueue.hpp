@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+
+using namespace std;
+
+//Fixed size ring for exactly one producer thread and one consumer thread. Neither side takes a lock:
+//the producer only writes tail, the consumer only writes head, and each publishes with a release store.
+//Capacity must be a power of two, one slot is always left empty to tell full from empty
+template<typename T, int Capacity>
+class SpscQueue{
+	static_assert((Capacity & (Capacity-1)) == 0, "SpscQueue capacity must be a power of two");
+
+	T slots[Capacity];
+
+	//Kept on separate cache lines so the two threads do not fight over one
+	alignas(64) atomic<int> head;
+	alignas(64) atomic<int> tail;
+
+	public:
+	SpscQueue(){
+		head = 0;
+		tail = 0;
+	}
+
+	//Producer only. Returns false when the queue is full
+	bool push(const T &item){
+		int t = tail.load(memory_order_relaxed);
+		int next = (t+1) & (Capacity-1);
+
+		if(next == head.load(memory_order_acquire)) return false;
+
+		slots[t] = item;
+		tail.store(next, memory_order_release);
+
+		return true;
+	}
+
+	//Consumer only. Returns false when the queue is empty
+	bool pop(T &item){
+		int h = head.load(memory_order_relaxed);
+
+		if(h == tail.load(memory_order_acquire)) return false;
+
+		item = slots[h];
+		head.store((h+1) & (Capacity-1), memory_order_release);
+
+		return true;
+	}
+
+	bool empty(){
+		return head.load(memory_order_acquire) == tail.load(memory_order_acquire);
+	}
+};
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <string>
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include "Exception.hpp"
+
+//Font the menus and HUD are drawn in, under media/fonts without the .ttf
+#define DEFAULT_FONT "aovel-sans-rounded-font/AovelSansRounded-rdDL"
+
+//Printable ASCII is rasterized, anything else is drawn as '?'
+#define FIRST_GLYPH 32
+#define LAST_GLYPH 126
+
+//Atlas rows wrap at this many pixels
+#define ATLAS_WIDTH 512
+
+//Laid out strings kept before the cache is emptied, so changing text like timings cannot grow it forever
+#define TEXT_CACHE_SIZE 256
+
+using namespace std;
+
+//Where one character of a string is copied from in the atlas and to, relative to the string's top left
+struct GlyphQuad{
+	SDL_Rect src, dst;
+};
+
+struct TextLayout{
+	vector<GlyphQuad> quads;
+	int w, h;
+};
+
+//Rasterizes a font's glyphs once into a single white texture, then draws any string in any colour as quads
+//copied out of it. Layouts are cached per string, so drawing the same text again costs only the copies
+class TextRenderer{
+	SDL_Renderer *ren;
+	SDL_Texture *atlas;
+	SDL_Rect glyphs[LAST_GLYPH-FIRST_GLYPH+1];
+	int advances[LAST_GLYPH-FIRST_GLYPH+1];
+	int lineHeight;
+
+	map<string, TextLayout> layouts;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	vector<SDL_Vertex> vertices;
+	vector<int> indices;
+#endif
+
+	int glyphIndex(char c){
+		if(c < FIRST_GLYPH || c > LAST_GLYPH) c = '?';
+		return c-FIRST_GLYPH;
+	}
+
+	public:
+	TextRenderer(SDL_Renderer *newRen, string fontName=DEFAULT_FONT, int size=25){
+		ren = newRen;
+		atlas = NULL;
+
+		bool ttfStarted = TTF_WasInit();
+		if(!ttfStarted) TTF_Init();
+
+		string filename = "media/fonts/" + fontName + ".ttf";
+		TTF_Font *font = TTF_OpenFont(filename.c_str(), size);
+		if(font == NULL) throw Exception("Could not load font " + filename);
+
+		lineHeight = TTF_FontHeight(font);
+
+		//Every glyph is rendered once and packed into rows, left to right
+		vector<SDL_Surface *> rendered;
+		SDL_Color white = {255, 255, 255, 255};
+		int x = 0, y = 0, rowH = 0;
+
+		for(int c=FIRST_GLYPH; c<=LAST_GLYPH; c++){
+			int i = c-FIRST_GLYPH;
+			int minX, maxX, minY, maxY;
+
+			advances[i] = 0;
+			TTF_GlyphMetrics(font, c, &minX, &maxX, &minY, &maxY, &advances[i]);
+
+			SDL_Surface *s = TTF_RenderGlyph_Blended(font, c, white);
+			rendered.push_back(s);
+
+			if(s == NULL){
+				glyphs[i] = {0, 0, 0, 0};
+				continue;
+			}
+
+			if(x+s->w > ATLAS_WIDTH){
+				x = 0;
+				y += rowH;
+				rowH = 0;
+			}
+
+			glyphs[i] = {x, y, s->w, s->h};
+			x += s->w;
+			rowH = max(rowH, s->h);
+		}
+
+		SDL_Surface *sheet = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, max(1, y+rowH), 32, SDL_PIXELFORMAT_RGBA32);
+		if(sheet == NULL) throw Exception("Could not create glyph atlas");
+
+		for(int i=0; i<(int)rendered.size(); i++){
+			if(rendered[i] == NULL) continue;
+
+			//Copy alpha as is rather than blending it onto the empty sheet
+			SDL_SetSurfaceBlendMode(rendered[i], SDL_BLENDMODE_NONE);
+			SDL_BlitSurface(rendered[i], NULL, sheet, &glyphs[i]);
+			SDL_FreeSurface(rendered[i]);
+		}
+
+		atlas = SDL_CreateTextureFromSurface(ren, sheet);
+		SDL_FreeSurface(sheet);
+		if(atlas == NULL) throw Exception("Could not create glyph atlas texture");
+
+		SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_BLEND);
+
+		TTF_CloseFont(font);
+		if(!ttfStarted) TTF_Quit();
+	}
+
+	int getLineHeight(){ return lineHeight; }
+
+	TextLayout &layout(const string &text){
+		auto found = layouts.find(text);
+		if(found != layouts.end()) return found->second;
+
+		if(layouts.size() >= TEXT_CACHE_SIZE) layouts.clear();
+
+		TextLayout &l = layouts[text];
+		int penX = 0;
+
+		for(char c:text){
+			int i = glyphIndex(c);
+
+			if(glyphs[i].w > 0){
+				GlyphQuad q = {glyphs[i], {penX, 0, glyphs[i].w, glyphs[i].h}};
+				l.quads.push_back(q);
+			}
+
+			penX += advances[i];
+		}
+
+		l.w = penX;
+		l.h = lineHeight;
+
+		return l;
+	}
+
+	SDL_Point measure(const string &text){
+		TextLayout &l = layout(text);
+		SDL_Point size = {l.w, l.h};
+
+		return size;
+	}
+
+	//Draws text with its top left at (x, y). All of a string's glyphs go to the renderer in one batch
+	void draw(const string &text, int x, int y, SDL_Color color){
+		TextLayout &l = layout(text);
+		if(l.quads.empty()) return;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+		int atlasW, atlasH;
+		SDL_QueryTexture(atlas, NULL, NULL, &atlasW, &atlasH);
+
+		vertices.clear();
+		indices.clear();
+
+		for(auto &q:l.quads){
+			int first = vertices.size();
+			float u0 = (float)q.src.x/atlasW, v0 = (float)q.src.y/atlasH;
+			float u1 = (float)(q.src.x+q.src.w)/atlasW, v1 = (float)(q.src.y+q.src.h)/atlasH;
+			float x0 = x+q.dst.x, y0 = y+q.dst.y;
+			float x1 = x0+q.dst.w, y1 = y0+q.dst.h;
+
+			vertices.push_back({{x0, y0}, color, {u0, v0}});
+			vertices.push_back({{x1, y0}, color, {u1, v0}});
+			vertices.push_back({{x1, y1}, color, {u1, v1}});
+			vertices.push_back({{x0, y1}, color, {u0, v1}});
+
+			int quad[6] = {first, first+1, first+2, first, first+2, first+3};
+			indices.insert(indices.end(), quad, quad+6);
+		}
+
+		SDL_RenderGeometry(ren, atlas, &vertices[0], vertices.size(), &indices[0], indices.size());
+#else
+		//Older SDL has no geometry call, but it still batches consecutive copies from one texture
+		SDL_SetTextureColorMod(atlas, color.r, color.g, color.b);
+		SDL_SetTextureAlphaMod(atlas, color.a);
+
+		for(auto &q:l.quads){
+			SDL_Rect dst = {x+q.dst.x, y+q.dst.y, q.dst.w, q.dst.h};
+			SDL_RenderCopy(ren, atlas, &q.src, &dst);
+		}
+#endif
+	}
+
+	~TextRenderer(){
+		if(atlas) SDL_DestroyTexture(atlas);
+	}
+};
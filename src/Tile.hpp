@@ -9,69 +9,117 @@
 #include "MediaManager.hpp"
 #include "Config.hpp"
 #include "Wave.hpp"
+#include "Camera.hpp"
+#include "DrawList.hpp"
+#include "TimerWheel.hpp"
+#include "Names.hpp"
 
 using namespace std;
 
-class Tile:public Particle{
+//What a character in a level file stands for. The tile types share their names with the tile animations
+enum TileType{TILE_EMPTY, TILE_PLAYER, TILE_FLOOR, TILE_CEILING, TILE_LWALL, TILE_RWALL, TILE_DOOR, TILE_NPC, TILE_BIG_NPC,
+    TILE_KEY, TILE_TYPE_COUNT};
+static const char *tileTypeNames[TILE_TYPE_COUNT] = {"empty", "player", "floor", "ceiling", "lWall", "rWall", "door", "basic",
+    "big", "key"};
+
+//Everything tiles built from the same config share, loaded once per config instead of once per tile:
+//each tile type's animation and how much sound it absorbs, and how fast a lit tile fades
+class TileArchetype{
+    NameTable<Animation *> animations;
+    NameTable<Mix_Chunk *> sounds;
+
+    public:
     Config *cfg;
-    SDL_Renderer *ren;
-    MediaManager *media;
+    int w, h;
+    Animation *looks[TILE_TYPE_COUNT]; //the animation named after the type, the default one where there is none
+    double absorption[TILE_TYPE_COUNT]; //share of a sound particle's energy lost bouncing off each type
+    double fadeRate; //alpha a lit tile loses per second
+
+    TileArchetype(MediaManager *media, Config *newCfg){
+        cfg = newCfg;
+        w = stoi((*cfg)["width"]);
+        h = stoi((*cfg)["height"]);
+
+        for(auto anim: cfg->getMany("animations")){
+            Animation *a = new Animation(0);
+            a->readAnimation(media, anim);
+            animations.set(Names::get().id(anim), a);
+        }
+
+        for(auto sound: cfg->getMany("sounds")){
+            sounds.set(Names::get().id(sound), media->readSound(sound));
+        }
+
+        Animation *defaultAnimation = animations[Names::get().id((*cfg)["defaultAnimation"])];
+        for(int i=0; i<TILE_TYPE_COUNT; i++){
+            looks[i] = animations[Names::get().id(tileTypeNames[i])];
+            if(looks[i] == NULL) looks[i] = defaultAnimation;
+        }
+
+        configure();
+    }
 
-    map<string,Animation *> animations;
-    map<string, Mix_Chunk *> sounds;
+    //How the tiles treat sound and light, read again when the config is reloaded. Sizes never change
+    void configure(){
+        for(int i=0; i<TILE_TYPE_COUNT; i++){
+            string key = string(tileTypeNames[i]) + ".absorb";
+            absorption[i] = stod(cfg->has(key) ? (*cfg)[key] : (*cfg)["absorb"]);
+        }
+
+        fadeRate = stod((*cfg)["fadeRate"]);
+    }
 
-    string tileType;
+    Mix_Chunk *getSound(int name){ return sounds[name]; }
+
+    ~TileArchetype(){
+        for(auto a:animations.all()) delete a;
+    }
+};
+
+class Tile:public Particle{
+    TileArchetype *kind;
+    TileType type;
+    bool door; //doors are walked through rather than collided with
+    TimerWheel *clock; //the map's, tiles fade by time on it rather than being updated each tick. NULL stands still
+    double litAt; //alpha drops the archetype's fadeRate per second from 255 at litAt
     
     protected:
     Animation *a;
     SDL_Rect dest;
-    Waves *waves;
     SDL_Point center;
     
 
     public:
-    Tile(MediaManager *newMedia, SDL_Renderer *newRen, Config *newCfg, string newType,
+    Tile(TileArchetype *newKind, TileType newType,
         double newx=0.0, double newy=0.0,
         double newv=0.0, int newtheta=0,
         double newax=0.0, double neway=0.0,
         double newdamp=0.0):Particle(newx, newy, newv, newtheta, newax, neway, newdamp){
 
-        ren = newRen;
-        media = newMedia;
-        cfg = newCfg;
+        kind = newKind;
+        type = newType;
         x = newx;
         y = newy;
-        dest.w = stoi((*cfg)["width"]);
-        dest.h = stoi((*cfg)["height"]);
-        center = {dest.w / 2, dest.h / 2};
-        
-        vector<string> newAnimations = cfg->getMany("animations");
-
-        for(auto anim: newAnimations){
-          animations[anim] = new Animation(0);
-          animations[anim]->readAnimation(media, anim);
-        }
-
-        a = animations[(*cfg)["defaultAnimation"]];
+        dest.x = x;
+        dest.y = y;
+        dest.w = kind->w;
+        dest.h = kind->h;
         
-        vector<string> newSounds = cfg->getMany("sounds");
+        center = {dest.w / 2, dest.h / 2};
 
-        for(auto sound: newSounds){
-          sounds[sound] = new Mix_Chunk();
-          sounds[sound] = media->readSound(sound);
-        }
-        
-        tileType = newType;
+        a = kind->looks[type];
+        door = type == TILE_DOOR;
+        if(door) dest.h = 64;
 
-        if (tileType == "floor") setFloor();
-        else if (tileType == "ceiling") setCeiling();
-        else if (tileType == "lWall") setLWall();
-        else if (tileType == "rWall") setRWall();
-        else if (tileType == "door") setDoor();
+        litAt = -INFINITY;
+        clock = NULL;
     }
 
     SDL_Rect *getDest(){ return &dest; }
-    string getType(){ return tileType; }
+    TileType getType(){ return type; }
+    bool isDoor(){ return door; }
+    bool isSolid(){ return !door; }
+    double getAbsorption(){ return kind->absorption[type]; }
 
     double getX(){ return x; }
     double getY(){ return y; }
@@ -84,22 +132,19 @@ class Tile:public Particle{
     Animation *getAnimation(){ return a; }
     void setAnimation(Animation *newA){ a = newA; }
 
-    void setFloor(){ setAnimation(animations["floor"]); }
-    void setCeiling(){ setAnimation(animations["ceiling"]); }
-    void setLWall(){ setAnimation(animations["lWall"]); }
-    void setRWall(){ setAnimation(animations["rWall"]); }
-    void setDoor(){ 
-        setAnimation(animations["door"]);
-        dest.h = 64;
-    }
-    
-    void lightUp(){ a->setTransparency(255); }
+    void setClock(TimerWheel *newClock){ clock = newClock; }
+    double now(){ return clock ? clock->now() : 0; }
+
+    void lightUp(){ litAt = now(); }
+    double getLitAt(){ return litAt; }
+    void setLitAt(double newLitAt){ litAt = newLitAt; }
+    int getAlpha(){ return (int)max(0.0, 255-kind->fadeRate*(now()-litAt)); }
 
     bool collide(SDL_Rect* pDest){
         SDL_bool collision = SDL_HasIntersection(&dest, pDest);
 
         if(collision){
-            if(tileType=="door"){
+            if(door){
                 lightUp();
             }
             return true;
@@ -107,26 +152,14 @@ class Tile:public Particle{
         return false;
     }
     
-    void update(double dt){
-        if(a->getTransparency() > 0) a->decTransparency(1);
-
-        a->update(dt);
-
-        dest.x = x;
-        dest.y = y;
-    }
-
-    void render(){
-        SDL_RenderCopy(ren, a->getTexture(), a->getFrame(), &dest);
+    //Every tile of a type shows the same animation frame, from the clock
+    void render(DrawList &frame, Camera *camera=NULL){
+        SDL_Rect screen = camera ? camera->toScreen(&dest) : dest;
+        frame.sprite(a->getTexture(), a->getFrame(a->advance(0, now())), screen, getAlpha());
     }
 
     bool inside(int x, int y){
         return (dest.x <= x && x <= dest.x + dest.w &&
                 dest.y <= y && y <= dest.y + dest.h);
     }
-
-    ~Tile(){
-        for (auto a:animations) delete a.second;
-        for (auto s:sounds) delete s.second;
-    }
 };
\ No newline at end of file
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <vector>
+#include <math.h>
+#include <SDL.h>
+
+#include "Tile.hpp"
+#include "ChunkCells.hpp"
+
+using namespace std;
+
+//First solid tile a moving box runs into. toi is the fraction of the motion completed before contact,
+//(nx, ny) the contact normal pointing out of the tile
+struct SweepHit{
+	bool hit;
+	double toi;
+	int nx, ny;
+	Tile *tile;
+};
+
+//What a box touched while moving through the grid
+struct TileContacts{
+	bool onTile; //standing on a solid tile once the move finished
+	bool landed; //hit a floor while falling, a footstep belongs at landX, landY
+	double landX, landY;
+	bool hitCeiling, hitWall;
+	bool touchedDoor;
+
+	int hitCount;
+	SweepHit hits[3];
+};
+
+//Level tiles indexed by cell so collision only looks at the cells a box covers or moves through.
+//A tile taller than a cell (doors) is entered in every cell it covers. Only loaded chunks have cells,
+//the rest of the level reads as empty
+class TileGrid{
+	ChunkCells<Tile *> cells;
+	int cols, rows;
+	int cellSize;
+
+	static const int MAX_SLIDES = 3;
+
+	public:
+	TileGrid(int newCellSize=32){
+		cellSize = newCellSize;
+		cols = 0;
+		rows = 0;
+	}
+
+	int getCols(){ return cols; }
+	int getRows(){ return rows; }
+	int getCellSize(){ return cellSize; }
+
+	void build(vector<Tile *> &tiles){
+		cols = 0;
+		rows = 0;
+
+		for(auto t:tiles){
+			cols = max(cols, (int)ceil((t->getX()+t->getW())/cellSize));
+			rows = max(rows, (int)ceil((t->getY()+t->getH())/cellSize));
+		}
+
+		cells.resize(cols, rows);
+		for(int r=0; r<rows; r+=CHUNK_TILES)
+			for(int c=0; c<cols; c+=CHUNK_TILES)
+				loadChunk(c, r);
+
+		for(auto t:tiles) insert(t);
+	}
+
+	//An empty grid of a known size with no chunk loaded, for levels whose tiles stream in and out
+	void resize(int newCols, int newRows){
+		cols = newCols;
+		rows = newRows;
+		cells.resize(cols, rows);
+	}
+
+	//The chunk holding cell (col, row). Tiles are only entered in the cells of loaded chunks
+	void loadChunk(int col, int row){
+		cells.load(col, row);
+	}
+
+	//Forgets every tile in the chunk holding cell (col, row)
+	void unloadChunk(int col, int row){
+		cells.unload(col, row);
+	}
+
+	bool isLoaded(int col, int row){
+		return col>=0 && col<cols && row>=0 && row<rows && cells.has(col, row);
+	}
+
+	void insert(Tile *t){
+		set(t, t);
+	}
+
+	//Clears the cells t covers, leaving any other tile's cells alone
+	void remove(Tile *t){
+		set(t, NULL);
+	}
+
+	void set(Tile *t, Tile *value){
+		int c0 = floor(t->getX()/cellSize), c1 = ceil((t->getX()+t->getW())/cellSize)-1;
+		int r0 = floor(t->getY()/cellSize), r1 = ceil((t->getY()+t->getH())/cellSize)-1;
+
+		for(int r=r0; r<=r1; r++)
+			for(int c=c0; c<=c1; c++)
+				if(isLoaded(c, r) && (value || cells.get(c, r)==t)) cells.at(c, r) = value;
+	}
+
+	Tile *at(int col, int row){
+		if(col<0 || col>=cols || row<0 || row>=rows) return NULL;
+		return cells.get(col, row);
+	}
+
+	int colOf(double x){ return (int)floor(x/cellSize); }
+	int rowOf(double y){ return (int)floor(y/cellSize); }
+
+	//Swept AABB of the box (x, y, w, h) moving by (dx, dy) against one tile.
+	//Boxes that only touch do not collide unless moving into each other
+	static SweepHit sweepTile(double x, double y, double w, double h, double dx, double dy, Tile *t){
+		SweepHit miss = {false, 1, 0, 0, NULL};
+
+		double tx = t->getX(), ty = t->getY(), tw = t->getW(), th = t->getH();
+
+		double xEntry, xExit, yEntry, yExit;
+
+		if(dx > 0){
+			xEntry = (tx-(x+w))/dx;
+			xExit = (tx+tw-x)/dx;
+		} else if(dx < 0){
+			xEntry = (tx+tw-x)/dx;
+			xExit = (tx-(x+w))/dx;
+		} else {
+			if(x+w <= tx || x >= tx+tw) return miss;
+			xEntry = -INFINITY;
+			xExit = INFINITY;
+		}
+
+		if(dy > 0){
+			yEntry = (ty-(y+h))/dy;
+			yExit = (ty+th-y)/dy;
+		} else if(dy < 0){
+			yEntry = (ty+th-y)/dy;
+			yExit = (ty-(y+h))/dy;
+		} else {
+			if(y+h <= ty || y >= ty+th) return miss;
+			yEntry = -INFINITY;
+			yExit = INFINITY;
+		}
+
+		double entry = max(xEntry, yEntry);
+		double exit = min(xExit, yExit);
+
+		//Already overlapping on both axes, let the box move out rather than trapping it
+		if(xEntry < -1e-9 && yEntry < -1e-9) return miss;
+		if(entry > exit || entry < -1e-9 || entry > 1) return miss;
+
+		SweepHit hit = {true, max(0.0, entry), 0, 0, t};
+
+		//Ties favour the vertical axis so corners land the box instead of stopping it
+		if(xEntry > yEntry) hit.nx = dx > 0 ? -1 : 1;
+		else hit.ny = dy > 0 ? -1 : 1;
+
+		return hit;
+	}
+
+	//Earliest solid tile hit by the box moving (dx, dy). Only cells spanned by the motion are visited
+	SweepHit sweep(double x, double y, double w, double h, double dx, double dy){
+		SweepHit best = {false, 1, 0, 0, NULL};
+
+		int c0 = colOf(min(x, x+dx)), c1 = colOf(max(x, x+dx)+w);
+		int r0 = rowOf(min(y, y+dy)), r1 = rowOf(max(y, y+dy)+h);
+
+		for(int r=max(r0, 0); r<=min(r1, rows-1); r++){
+			for(int c=max(c0, 0); c<=min(c1, cols-1); c++){
+				Tile *t = cells.get(c, r);
+				if(t==NULL || !t->isSolid()) continue;
+
+				SweepHit hit = sweepTile(x, y, w, h, dx, dy, t);
+				if(hit.hit && hit.toi < best.toi) best = hit;
+			}
+		}
+
+		return best;
+	}
+
+	//The solid tile directly under the box's feet, within a pixel, or NULL
+	Tile *ground(double x, double y, double w, double h){
+		double feet = y+h;
+		int r = rowOf(feet+0.5);
+
+		for(int c=colOf(x); c<=colOf(x+w-1e-9); c++){
+			Tile *t = at(c, r);
+			if(t && t->isSolid() && fabs(t->getY()-feet) < 1.0) return t;
+		}
+
+		return NULL;
+	}
+
+	//Moves the box by its velocity over dt, sliding along whatever it hits. A hit zeroes the
+	//velocity along its normal and the box is snapped flush to the tile's face
+	TileContacts move(double &x, double &y, double w, double h, double &vx, double &vy, double dt, bool wasOnTile){
+		TileContacts contacts = {false, false, 0, 0, false, false, false, 0, {}};
+
+		double dx = vx*dt, dy = vy*dt;
+
+		for(int i=0; i<MAX_SLIDES && (dx!=0 || dy!=0); i++){
+			SweepHit hit = sweep(x, y, w, h, dx, dy);
+
+			if(!hit.hit){
+				x += dx;
+				y += dy;
+				break;
+			}
+
+			contacts.hits[contacts.hitCount++] = hit;
+
+			x += dx*hit.toi;
+			y += dy*hit.toi;
+
+			double remaining = 1-hit.toi;
+
+			if(hit.nx != 0){
+				x = hit.nx < 0 ? hit.tile->getX()-w : hit.tile->getX()+hit.tile->getW();
+				dx = 0;
+				vx = 0;
+				dy *= remaining;
+				contacts.hitWall = true;
+			} else {
+				if(hit.ny < 0){
+					if(!wasOnTile && vy > 0){
+						contacts.landed = true;
+						contacts.landX = x;
+						contacts.landY = hit.tile->getY()-3;
+					}
+					y = hit.tile->getY()-h;
+				} else {
+					y = hit.tile->getY()+hit.tile->getH();
+					contacts.hitCeiling = true;
+				}
+				dy = 0;
+				vy = 0;
+				dx *= remaining;
+			}
+		}
+
+		Tile *floor = vy >= 0 ? ground(x, y, w, h) : NULL;
+		if(floor){
+			contacts.onTile = true;
+			y = floor->getY()-h;
+		}
+		contacts.touchedDoor = touchDoors(x, y, w, h);
+
+		return contacts;
+	}
+
+	//Lights and reports any door the box overlaps
+	bool touchDoors(double x, double y, double w, double h){
+		bool touched = false;
+		SDL_Rect box = {(int)x, (int)y, (int)w, (int)h};
+
+		for(int r=rowOf(y); r<=rowOf(y+h); r++){
+			for(int c=colOf(x); c<=colOf(x+w); c++){
+				Tile *t = at(c, r);
+				if(t && t->isDoor() && t->collide(&box)) touched = true;
+			}
+		}
+
+		return touched;
+	}
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <math.h>
+
+using namespace std;
+
+#define TIMER_TICK 0.001 //s per tick of the wheel
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_LEVELS 4 //covers 64^4 ticks, about 4.6 hours, before a timer has to wait at the top level for another turn
+#define TIMER_RESERVE 32 //timers room is made for up front, so a game's first few timers never grow the lists mid tick
+
+typedef long long TimerId;
+
+//Hierarchical timer wheel. Each level has 64 slots, a slot at level L spanning 64^L ticks. A timer goes in the
+//lowest level whose span still reaches its due tick, and falls a level each time the wheel turns over that slot,
+//so scheduling and cancelling are O(1) and advancing only touches the slots it passes.
+//Single threaded: timers fire from advance, on whichever thread calls it
+class TimerWheel{
+	struct Timer{
+		long long due;
+		function<void()> fire;
+		int prev, next; //neighbours in its slot's list, -1 at either end
+		int level, slot; //level -1 while free, slot -1 once due and waiting to fire
+		unsigned generation; //bumped on reuse so stale ids cancel nothing
+	};
+
+	vector<Timer> timers;
+	vector<int> freeTimers;
+	vector<pair<int, unsigned>> firing; //timers due this tick and the generation each was due in
+	int heads[TIMER_LEVELS][TIMER_SLOTS];
+	long long tick;
+	double carry; //s advanced but not yet a whole tick
+	int pending;
+
+	void link(int i){
+		Timer &t = timers[i];
+
+		//The highest group of slot bits the due tick differs from now in picks the level
+		int level = 0;
+		while(level < TIMER_LEVELS-1 && ((t.due ^ tick) >> (TIMER_SLOT_BITS*(level+1))) != 0) level++;
+
+		t.level = level;
+		t.slot = (t.due >> (TIMER_SLOT_BITS*level)) & (TIMER_SLOTS-1);
+		t.prev = -1;
+		t.next = heads[level][t.slot];
+		if(t.next >= 0) timers[t.next].prev = i;
+		heads[level][t.slot] = i;
+	}
+
+	void unlink(int i){
+		Timer &t = timers[i];
+
+		if(t.prev >= 0) timers[t.prev].next = t.next;
+		else heads[t.level][t.slot] = t.next;
+		if(t.next >= 0) timers[t.next].prev = t.prev;
+
+		t.level = -1;
+	}
+
+	//Detaches a whole slot and hands back its first timer
+	int take(int level, int slot){
+		int first = heads[level][slot];
+		heads[level][slot] = -1;
+
+		return first;
+	}
+
+	void release(int i){
+		timers[i].fire = nullptr;
+		timers[i].level = -1;
+		timers[i].generation++;
+		freeTimers.push_back(i);
+		pending--;
+	}
+
+	void step(){
+		tick++;
+
+		//Each higher level whose slot the wheel has just reached is spread back down over the levels below
+		for(int level=1; level<TIMER_LEVELS; level++){
+			if((tick & ((1LL << (TIMER_SLOT_BITS*level))-1)) != 0) break;
+
+			for(int i=take(level, (tick >> (TIMER_SLOT_BITS*level)) & (TIMER_SLOTS-1)); i>=0;){
+				int next = timers[i].next;
+				link(i);
+				i = next;
+			}
+		}
+
+		firing.clear();
+		for(int i=take(0, tick & (TIMER_SLOTS-1)); i>=0; i=timers[i].next){
+			timers[i].slot = -1;
+			firing.push_back(make_pair(i, timers[i].generation));
+		}
+
+		//Each is freed before it fires, so a callback may schedule another timer or cancel any, even one due now
+		for(auto &due:firing){
+			if(timers[due.first].generation != due.second) continue;
+
+			function<void()> fire = timers[due.first].fire;
+			release(due.first);
+			fire();
+		}
+	}
+
+	public:
+	TimerWheel(){
+		tick = 0;
+		carry = 0;
+		pending = 0;
+
+		timers.reserve(TIMER_RESERVE);
+		freeTimers.reserve(TIMER_RESERVE);
+		firing.reserve(TIMER_RESERVE);
+
+		for(int level=0; level<TIMER_LEVELS; level++)
+			for(int slot=0; slot<TIMER_SLOTS; slot++) heads[level][slot] = -1;
+	}
+
+	//Seconds the wheel has been advanced, to the tick
+	double now(){ return tick*TIMER_TICK; }
+	int size(){ return pending; }
+
+	//Calls fire once delay s from now, at the earliest on the next tick
+	TimerId schedule(double delay, function<void()> fire){
+		int i;
+
+		if(freeTimers.empty()){
+			timers.push_back(Timer());
+			i = timers.size()-1;
+			timers[i].generation = 0;
+		} else {
+			i = freeTimers.back();
+			freeTimers.pop_back();
+		}
+
+		timers[i].due = tick + max(1LL, (long long)ceil(delay/TIMER_TICK - 1e-9));
+		timers[i].fire = fire;
+		link(i);
+		pending++;
+
+		return ((TimerId)timers[i].generation << 32) | i;
+	}
+
+	//False when the timer has already fired or been cancelled
+	bool cancel(TimerId id){
+		int i = (int)(id & 0xFFFFFFFF);
+		if(i < 0 || i >= (int)timers.size()) return false;
+		if(timers[i].generation != (unsigned)(id >> 32) || timers[i].level < 0) return false;
+
+		if(timers[i].slot >= 0) unlink(i);
+		release(i);
+
+		return true;
+	}
+
+	void advance(double dt){
+		carry += dt;
+
+		//Rounded so a dt that is a whole number of ticks always advances by exactly that many
+		long long steps = (long long)floor(carry/TIMER_TICK + 1e-6);
+		carry -= steps*TIMER_TICK;
+
+		for(long long i=0; i<steps; i++) step();
+	}
+};
@@ -8,146 +8,692 @@
 #include "Particle.hpp"
 #include "MediaManager.hpp"
 #include "Animation.hpp"
+#include "Profiler.hpp"
+#include "AllocTracker.hpp"
+#include "Camera.hpp"
+#include "DrawList.hpp"
+#include "Config.hpp"
+#include "PathCache.hpp"
 
 #define PI 3.14159265
 
+//Headings are whole degrees, so a wave never has more particles than this
+#define MAX_WAVE_PARTICLES 360
+//Finished waves kept to be started again rather than freed, so a steady trickle of sounds stops allocating
+#define WAVE_SPARES 16
+
+//How the wave of one sound looks and spreads, read from config/waves.conf
+struct WaveProfile{
+	Mix_Chunk *sound;
+	double speed, damp;
+	double color, decay; //starting brightness and how much of it is lost per second
+	int size; //px per side of a drawn particle
+	int particles; //particles the wave starts with
+	double spacing; //px apart neighbouring particles may drift before one is added between them
+
+	//Another wave of this sound started within mergeRadius px and mergeWindow s of a live one is folded into it,
+	//raising its brightness by mergeBoost of the starting color, up to mergeCap times the starting color
+	double mergeRadius, mergeWindow, mergeBoost, mergeCap;
+
+	//A particle loses falloff of its energy per px it travels and the absorption of each tile it bounces off,
+	//and is retired once it has minEnergy or less left
+	double falloff, minEnergy;
+};
+
+//One particle of a simulated wave and what the wave tracks about it
+struct WaveParticle{
+	Particle p; //held in place, a wave's particles come and go without touching the heap
+	double energy; //1 at the start, lost with distance and at each reflection
+	int track; //track it records into while the wave is being recorded
+	SDL_Point hit; //tile it bounced off this tick, x=-1 for none
+	bool gapAfter; //the next particle round the ring is not its neighbour any more, one between them was retired
+};
+
 class Wave{
-	vector <Particle*> particles;
+	vector <WaveParticle> particles; //live particles only, in ring order
+	vector <WaveParticle> split; //next ring of particles while update adds to it or retires from it
 	
 	SDL_Renderer *ren;
 
 	double color;
 	int size;
 	double decayRate;
+	double speed, damp, spacing;
+	double age; //s since the wave started
+	SDL_Rect bound;
+	long retired;
 
-	public:
-	Wave(SDL_Renderer *newRen, int startX, int startY, double waveSpeed=100, double waveDamp=0.8,
-		double startColor=255, double newDecayRate=100, int newSize=3){
+	WaveProfile *profile;
+	int originX, originY;
 
-		
+	//A wave either simulates its particles, optionally recording them for the path cache, or replays a recording.
+	//A recording is drafted a track at a time into buffers the wave keeps when it is restarted, and only copied
+	//out into one WavePath once the wave is done
+	bool recording;
+	vector<PathTrack> draft;
+	vector<vector<PathSegment>> draftSegments;
+	int drafted; //tracks of draft in use
+	double reach;
+	shared_ptr<WavePath> path;
+	int recordTicket; //the path cache's ticket for the recording
+	vector<int> cursor; //segment each replayed track is on
+	vector<SDL_Point> hits; //tiles replayed particles reached since they were last taken
+
+	WaveParticle newParticle(double x, double y, int theta, double energy=1.0){
+		//The accelerations for each sound particle are set at 0 on purpose
+		//Waves acceleration should not change!
+		WaveParticle wp = {Particle(x, y, speed, theta, 0.0, 0.0, damp), energy, -1, SDL_Point{-1, -1}, false};
+		wp.p.setBound(bound.x, bound.y, bound.w, bound.h);
+		if(recording) wp.track = newTrack(&wp.p);
+
+		return wp;
+	}
+
+	//A wavefront starts with a few particles and gains more as it grows, by adding one halfway between any two
+	//neighbours that have spread further than spacing apart, down to a degree between headings
+	void addParticles(){
+		int n = particles.size();
+		if(n >= MAX_WAVE_PARTICLES || n < 2) return;
+
+		split.clear();
+
+		for(int i=0; i<n; i++){
+			WaveParticle &a = particles[i], &b = particles[(i+1)%n];
+			split.push_back(a);
+			if(a.gapAfter) continue;
+
+			double dx = b.p.getX()-a.p.getX(), dy = b.p.getY()-a.p.getY();
+			if(dx*dx+dy*dy <= spacing*spacing) continue;
+
+			//Signed angle from a's heading to b's, in -180..179
+			int gap = ((b.p.getTheta()-a.p.getTheta())%360+540)%360-180;
+			if(abs(gap) < 2) continue;
+
+			split.push_back(newParticle((a.p.getX()+b.p.getX())/2, (a.p.getY()+b.p.getY())/2,
+				((a.p.getTheta()+gap/2)%360+360)%360, (a.energy+b.energy)/2));
+		}
+
+		if(split.size() > particles.size()) particles.swap(split);
+	}
+
+	//Drops every particle whose energy has run out, keeping the rest in ring order so update, collision and
+	//render only ever walk live particles
+	void retire(){
+		int n = particles.size(), live = 0;
+		while(live < n && particles[live].energy > profile->minEnergy) live++;
+		if(live == n) return;
+
+		for(int i=live; i<n; i++){
+			WaveParticle &wp = particles[i];
+
+			if(wp.energy > profile->minEnergy){
+				particles[live++] = wp;
+				continue;
+			}
+
+			if(recording) draft[wp.track].died = age;
+			if(live > 0) particles[live-1].gapAfter = true;
+			else if(n > 1) particles[n-1].gapAfter = true; //wraps round to the last particle, still unmoved
+		}
+
+		retired += n-live;
+		particles.resize(live);
+		Profiler::get().count(COUNTER_PARTICLES_RETIRED, n-live);
+	}
+
+	//Particles past the bound have left the level and would only bounce round its margin
+	bool outOfBound(Particle *p){
+		if(bound.w == bound.x || bound.h == bound.y) return false;
+
+		return p->getX() <= bound.x || p->getX() >= bound.w || p->getY() <= bound.y || p->getY() >= bound.h;
+	}
+
+	PathSegment segment(Particle *p, SDL_Point hit){
+		double heading = p->getTheta()*PI/180;
+		PathSegment s = {(float)age, (float)p->getX(), (float)p->getY(), (float)(speed*cos(heading)), (float)(speed*sin(heading)), hit.x, hit.y};
+
+		return s;
+	}
+
+	int newTrack(Particle *p){
+		if(drafted == (int)draft.size()){
+			draft.push_back(PathTrack());
+			draftSegments.push_back(vector<PathSegment>());
+		}
+
+		draft[drafted].born = age;
+		draft[drafted].died = INFINITY;
+		draftSegments[drafted].clear();
+		draftSegments[drafted].push_back(segment(p, SDL_Point{-1, -1}));
+
+		return drafted++;
+	}
+
+	void replayTo(){
+		for(unsigned k=0; k<path->tracks.size(); k++){
+			PathTrack &t = path->tracks[k];
+			if(t.born > age) break;
+
+			while(cursor[k]+1 < t.count && path->segments[t.first+cursor[k]+1].t <= age){
+				cursor[k]++;
+
+				PathSegment &s = path->segments[t.first+cursor[k]];
+				if(s.hitCol >= 0) hits.push_back(SDL_Point{s.hitCol, s.hitRow});
+			}
+		}
+	}
+
+	public:
+	Wave(SDL_Renderer *newRen, int startX, int startY, WaveProfile &newProfile, SDL_Rect newBound={0, 0, 0, 0}){
 		ren = newRen;
-		color = startColor;
-		decayRate = newDecayRate;
-		size = newSize;
-
-		for(int i=0; i < 360; i++){
-			//The accelerations for each sound particle are set at 0 on purpose
-			//Waves acceleration should not change!
-            particles.push_back(new Particle(startX, startY, waveSpeed, i, 0.0, 0.0, waveDamp));
-		 	particles[i]->setBound();
+		start(startX, startY, newProfile, newBound);
+	}
+
+	//Sets the wave off again from scratch. A finished wave restarted this way keeps the room its particles had
+	void start(int startX, int startY, WaveProfile &newProfile, SDL_Rect newBound={0, 0, 0, 0}){
+		color = newProfile.color;
+		decayRate = newProfile.decay;
+		size = newProfile.size;
+		speed = newProfile.speed;
+		damp = newProfile.damp;
+		spacing = newProfile.spacing;
+		bound = newBound;
+		age = 0;
+		retired = 0;
+
+		profile = &newProfile;
+		originX = startX;
+		originY = startY;
+		recordTicket = 0;
+
+		particles.clear();
+		split.clear();
+		recording = false;
+		drafted = 0;
+		path.reset();
+		cursor.clear();
+		hits.clear();
+
+		int count = max(1, min(MAX_WAVE_PARTICLES, newProfile.particles));
+
+		for(int i=0; i < count; i++){
+            particles.push_back(newParticle(startX, startY, i*360/count));
         }
 	}
 
 	Particle *operator[] (int index){
-		return particles[index];
+		return &particles[index].p;
+	}
+
+	int getSize(){
+		if(!path) return particles.size();
+
+		int live = 0;
+		for(auto &t:path->tracks){
+			if(t.born > age) break;
+			if(t.died > age) live++;
+		}
+
+		return live;
+	}
+
+	double getAge(){ return age; }
+	WaveProfile *getProfile(){ return profile; }
+	int getOriginX(){ return originX; }
+	int getOriginY(){ return originY; }
+
+	//Starts recording every particle's flight. Call before the first update
+	void record(int ticket){
+		recording = true;
+		drafted = 0;
+		reach = 0;
+		recordTicket = ticket;
+
+		for(auto &wp:particles) wp.track = newTrack(&wp.p);
+	}
+
+	bool isRecording(){ return recording; }
+	int getRecordTicket(){ return recordTicket; }
+	double getReach(){ return reach; }
+
+	shared_ptr<WavePath> takeRecording(){
+		shared_ptr<WavePath> done = make_shared<WavePath>();
+		done->duration = age;
+		done->reach = reach;
+
+		int total = 0;
+		for(int k=0; k<drafted; k++) total += draftSegments[k].size();
+
+		done->tracks.reserve(drafted);
+		done->segments.reserve(total);
+
+		for(int k=0; k<drafted; k++){
+			PathTrack t = draft[k];
+			t.first = done->segments.size();
+			t.count = draftSegments[k].size();
+
+			done->tracks.push_back(t);
+			done->segments.insert(done->segments.end(), draftSegments[k].begin(), draftSegments[k].end());
+		}
+
+		recording = false;
+		return done;
+	}
+
+	//Live particle i bounced off the tile at (col, row), which soaks up absorption of its energy
+	void reflect(int i, int col, int row, double absorption){
+		particles[i].energy *= 1-absorption;
+		particles[i].hit = SDL_Point{col, row};
+	}
+
+	//Called once collisions are done each tick. A particle that turned, was moved or hit a tile starts a new segment
+	//of its recording, and any that hit its last tile is retired
+	void endCollisions(){
+		if(recording){
+			for(auto &wp:particles){
+				Particle *p = &wp.p;
+				vector<PathSegment> &segments = draftSegments[wp.track];
+				PathSegment &last = segments.back();
+				PathSegment now = segment(p, wp.hit);
+
+				double t = age-last.t;
+				bool straight = fabs(now.vx-last.vx) < 1e-3 && fabs(now.vy-last.vy) < 1e-3
+					&& fabs(now.x-(last.x+last.vx*t)) < 0.5 && fabs(now.y-(last.y+last.vy*t)) < 0.5;
+
+				if(!straight || wp.hit.x >= 0) segments.push_back(now);
+
+				double dx = p->getX()-originX, dy = p->getY()-originY;
+				reach = max(reach, sqrt(dx*dx+dy*dy));
+			}
+		}
+
+		for(auto &wp:particles) wp.hit = SDL_Point{-1, -1};
+		retire();
 	}
 
-	void drawParticle(int x, int y){
-		for(int i=0; i<size; i++)
-			for(int j=0; j<size; j++)
-				SDL_RenderDrawPoint(ren, x+i, y+j);
+	//Replays a recorded path instead of simulating. The wave's own particles are dropped
+	void replay(shared_ptr<WavePath> recorded){
+		particles.clear();
+
+		path = recorded;
+		cursor.assign(path->tracks.size(), 0);
+	}
+
+	bool isReplaying(){ return (bool)path; }
+
+	//A simulated wave is done once every particle is retired, a replayed one once its recording runs out
+	bool isFinished(){ return path ? age > path->duration : particles.empty(); }
+
+	//Tiles the replayed particles have reached since the last call
+	vector<SDL_Point> &takeHits(){ return hits; }
+
+	//Whether a wave of the same sound started at (x, y) now would be indistinguishable from this one
+	bool absorbs(WaveProfile *other, int x, int y){
+		if(other != profile || age > profile->mergeWindow) return false;
+
+		double dx = x-originX, dy = y-originY;
+		return dx*dx+dy*dy <= profile->mergeRadius*profile->mergeRadius;
+	}
+
+	void boost(){
+		color = min(color + profile->mergeBoost*profile->color, profile->mergeCap*profile->color);
 	}
 
 	void update(double dt){
 		color -= (dt*decayRate);
+		age += dt;
+
+		if(path){
+			replayTo();
+			return;
+		}
+
+		double travelled = profile->falloff*speed*dt;
 		
-		for(unsigned i=0; i<particles.size(); i++){
-            particles[i]->update(dt);
+		for(auto &wp:particles){
+            wp.p.update(dt);
+			wp.energy = outOfBound(&wp.p) ? 0 : wp.energy-travelled;
         }
+		retire();
+
+		//Neighbours are only compared once an unobstructed ring of this many particles would be spaced too far apart
+		if(2*PI*speed*age > spacing*(particles.size()+retired)) addParticles();
 	}
 
-	void render(){
-		SDL_SetRenderDrawColor(ren, color, color, color, 255);
+	//Particles outside the camera's view are skipped
+	void render(DrawList &frame, Camera *camera=NULL){
+		frame.beginWave(color);
 
-		for(unsigned i=0; i<particles.size(); i++){
-			drawParticle(particles[i]->getX(), particles[i]->getY());
-		}
+		SDL_Rect view = camera ? camera->view() : SDL_Rect{0, 0, 0, 0};
+		int count = path ? path->tracks.size() : particles.size();
+
+		for(int i=0; i<count; i++){
+			int x, y;
+
+			if(path){
+				PathTrack &t = path->tracks[i];
+				if(t.born > age) break;
+				if(t.died <= age) continue;
+
+				PathSegment &s = path->segments[t.first+cursor[i]];
+				x = s.x + s.vx*(age-s.t);
+				y = s.y + s.vy*(age-s.t);
+			} else {
+				x = particles[i].p.getX();
+				y = particles[i].p.getY();
+			}
 
-		SDL_SetRenderDrawColor(ren, 0x00, 0x00, 0x00, 0xFF);
+			if(camera){
+				if(x+size <= view.x || x >= view.x+view.w || y+size <= view.y || y >= view.y+view.h) continue;
+				x -= view.x;
+				y -= view.y;
+			}
+
+			frame.particle(x, y, size);
+		}
 	}
 
 	double getColor(){ return color; }
+};
 
-	~Wave(){
-		for (auto p:particles) 
-			delete p;
-	}
+//Says how loud a sound made at (x, y) is wherever the player is listening, from 0 to 1
+class SoundListener{
+	public:
+	virtual double volumeAt(double x, double y)=0;
+	virtual ~SoundListener(){}
 };
 
 class Waves{
+	MediaManager *media;
 	SDL_Renderer *ren;
 	vector <Wave *> waves;
+	vector <Wave *> spares; //finished waves, oldest first
 	SDL_mutex *waveMutex;
+	SoundListener *listener;
+	SDL_Rect bound; //minimum and maximum corner handed to new particles, all zero for none
+
+	Config profileConf;
+	map<string, WaveProfile> profiles;
+
+	long merged; //waves folded into an existing one instead of being started
+	long liveParticles; //in every live wave as of the last update
+
+	//Recorded flights by sound and origin, origins rounded to pathSnap px so nearby waves share one.
+	//Only used once a level has called resetPaths, since a recording needs its tiles
+	PathCache paths;
+	int pathSnap;
+	bool usePaths;
+
+	int snap(int v){ return (int)floor((double)v/pathSnap+0.5)*pathSnap; }
+
+	//A wave that has stopped is kept to be started again, unless there are spares enough already
+	void spare(Wave *w){
+		if(spares.size() < WAVE_SPARES) spares.push_back(w);
+		else delete w;
+	}
+
+	double profileValue(string sound, string key){
+		return stod(profileConf.has(sound+"."+key) ? profileConf[sound+"."+key] : profileConf[key]);
+	}
+
+	void readProfile(string sound, WaveProfile &p){
+		p.speed = profileValue(sound, "speed");
+		p.damp = profileValue(sound, "damp");
+		p.color = profileValue(sound, "color");
+		p.decay = profileValue(sound, "decay");
+		p.size = (int)profileValue(sound, "size");
+		p.particles = (int)profileValue(sound, "particles");
+		p.spacing = profileValue(sound, "spacing");
+		p.mergeRadius = profileValue(sound, "mergeRadius");
+		p.mergeWindow = profileValue(sound, "mergeWindow");
+		p.mergeBoost = profileValue(sound, "mergeBoost");
+		p.mergeCap = profileValue(sound, "mergeCap");
+		p.falloff = profileValue(sound, "falloff");
+		p.minEnergy = profileValue(sound, "minEnergy");
+	}
 
 	public:
-	Waves(SDL_Renderer *newRen){
+	Waves(MediaManager *newMedia, SDL_Renderer *newRen):profileConf("waves"){
+		media = newMedia;
 		ren = newRen;
 		waveMutex = SDL_CreateMutex();
+		listener = NULL;
+		bound = {0, 0, 0, 0};
+		merged = 0;
+		liveParticles = 0;
+
+		paths.setCapacity(stoul(profileConf["pathCacheKB"])*1024);
+		pathSnap = max(1, stoi(profileConf["pathSnap"]));
+		usePaths = false;
+
+		spares.reserve(WAVE_SPARES);
+	}
+
+	//The profile for a sound, read once. Keys in waves.conf named sound.key override the plain key for that sound
+	WaveProfile *profile(string sound){
+		if(profiles.find(sound)==profiles.end()){
+			profiles[sound].sound = media->readSound(sound);
+			readProfile(sound, profiles[sound]);
+		}
+
+		return &profiles[sound];
 	}
 
+	//Re-reads waves.conf into the profiles already handed out, so every holder sees the new values.
+	//Recorded paths were flown with the old ones and are dropped
+	void reloadProfiles(){
+		//Read into copies first, live waves hold pointers to the profiles
+		map<string, WaveProfile> reloaded;
+		size_t capacity;
+		int snap;
+
+		profileConf.reload([&]{
+			reloaded = profiles;
+			for(auto &p:reloaded) readProfile(p.first, p.second);
+			capacity = stoul(profileConf["pathCacheKB"])*1024;
+			snap = max(1, stoi(profileConf["pathSnap"]));
+		});
+
+		SDL_LockMutex(waveMutex);
+
+		for(auto &p:reloaded) profiles[p.first] = p.second;
+		paths.setCapacity(capacity);
+		pathSnap = snap;
+		paths.clear();
+
+		SDL_UnlockMutex(waveMutex);
+	}
+
+	//The box new waves bounce inside, normally the level plus a tile of margin
+	void setBound(int minX, int minY, int maxX, int maxY){
+		bound = {minX, minY, maxX, maxY};
+	}
+
+	//Without a listener every sound plays at full volume
+	void setListener(SoundListener *newListener){ listener = newListener; }
+	SoundListener *getListener(){ return listener; }
+
 	Wave *operator[] (int index){
 		return waves[index];
 	}
 
-	void createWave(Mix_Chunk *sound, int startingX, int startingY, double waveSpeed=100, double waveDamp=0.8,
-		double startColor=255, double decayRate=100, int size=3){
-		
-		//we could associate these properties with the actual sounds and have them read in config style. That may be a good choice
+	int size(){ return waves.size(); }
+	long getMerged(){ return merged; }
+	long getParticles(){ return liveParticles; }
+
+	PathCache &getPaths(){ return paths; }
+
+	//A new level: every recorded path is dropped and recording starts against the new tiles
+	void resetPaths(){
+		SDL_LockMutex(waveMutex);
+		paths.clear();
+		usePaths = true;
+		SDL_UnlockMutex(waveMutex);
+	}
+
+	//Tiles in the level pixels x0..x1, y0..y1 changed, so paths that could have reached them are stale
+	void invalidatePaths(int x0, int y0, int x1, int y1){
+		SDL_LockMutex(waveMutex);
+		for(auto w:waves)
+			if(w->isRecording()) paths.reached(w->getRecordTicket(), w->getReach());
+
+		paths.invalidate(x0, y0, x1, y1);
+		SDL_UnlockMutex(waveMutex);
+	}
+
+	//A wave close in place and time to a live one of the same sound only brightens that one, and its sound,
+	//which would land on top of the first, is not played again
+	void createWave(WaveProfile *profile, int startingX, int startingY){
+		ALLOC_SCOPE(ALLOC_WAVES);
+
+		bool cached = usePaths && paths.isEnabled();
+		if(cached){
+			startingX = snap(startingX);
+			startingY = snap(startingY);
+		}
+
 		if(SDL_LockMutex(waveMutex)==0){
-			waves.push_back(new Wave(ren, startingX, startingY, waveSpeed, waveDamp, startColor, decayRate, size));
+			//Waves are kept oldest first, so only the young ones at the back are looked at
+			for(int i=waves.size()-1; i>=0 && waves[i]->getAge() <= profile->mergeWindow; i--){
+				if(waves[i]->absorbs(profile, startingX, startingY)){
+					waves[i]->boost();
+					merged++;
+					Profiler::get().count(COUNTER_WAVES_MERGED, 1);
+
+					SDL_UnlockMutex(waveMutex);
+					return;
+				}
+			}
+
+			Wave *w;
+			if(spares.empty()) w = new Wave(ren, startingX, startingY, *profile, bound);
+			else {
+				w = spares.back();
+				spares.pop_back();
+				w->start(startingX, startingY, *profile, bound);
+			}
+
+			if(cached){
+				shared_ptr<WavePath> recorded = paths.find(PathKey{profile, startingX, startingY});
+
+				if(recorded) w->replay(recorded);
+				else w->record(paths.beginRecording(startingX, startingY));
+			}
+
+			waves.push_back(w);
 			SDL_UnlockMutex(waveMutex);
 		}
 
-		Mix_PlayChannel(-1,sound,0);
+		//The wave itself is only drawn, how loud the sound is comes from the listener
+		media->playSound(profile->sound, 0, listener ? listener->volumeAt(startingX, startingY) : 1.0);
 	}
 
 	void deleteWaves(){
-		while (waves.size()>0){ waves.erase(waves.begin());}
+		if(SDL_LockMutex(waveMutex)==0){
+			for (auto w:waves){
+				if(w->isRecording()) paths.abandon(w->getRecordTicket());
+				spare(w);
+			}
+			waves.clear();
+
+			SDL_UnlockMutex(waveMutex);
+		}
 	}
 
-	bool collideSound(Particle *newP){
-		bool hasCollision = false;
+	//Bounces every particle off whichever tile of grid it is inside, one lookup per particle however
+	//large the level is, and lets a struck tile react through its own collide
+	template<typename Grid>
+	void collideGrid(Grid &grid){
+		PROFILE_SCOPE("Waves::collideGrid");
+		ALLOC_SCOPE(ALLOC_WAVES);
+
 		if(SDL_LockMutex(waveMutex)==0){
+			long tests = 0;
+
 			for(auto w:waves){
-				for(int i=0; i<360; i++) {
-					if((*w)[i]->collide(newP)){
-						hasCollision = true;
+				//A replayed wave only has to pass on the tiles its recording struck
+				if(w->isReplaying()){
+					for(auto &h:w->takeHits()){
+						auto t = grid.at(h.x, h.y);
+						if(t) t->collide(t->getDest());
 					}
+					w->takeHits().clear();
+					continue;
 				}
+
+				tests += w->getSize();
+
+				for(int i=0; i<w->getSize(); i++){
+					Particle *p = (*w)[i];
+					int col = grid.colOf(p->getX()), row = grid.rowOf(p->getY());
+					auto t = grid.at(col, row);
+
+					if(t && p->collide(t)){
+						t->collide(t->getDest());
+						w->reflect(i, col, row, t->getAbsorption());
+					}
+				}
+
+				w->endCollisions();
 			}
 
+			Profiler::get().count(COUNTER_COLLISION_TESTS, tests);
+
 			SDL_UnlockMutex(waveMutex);
 		}
-
-		return hasCollision;
 	}
-	
+
 	void updateWaves(double dt){
+		PROFILE_SCOPE("Waves::updateWaves");
+		ALLOC_SCOPE(ALLOC_WAVES);
+
 		if(SDL_LockMutex(waveMutex)==0){
+			long particles = 0;
+
 			if(waves.size() > 0){
 				for(int i=waves.size()-1; i >=0; i--){
 					waves[i]->update(dt);
 
 					//Once a wave has become invisible it is deleted
 					//This means we are not allowing fully invisible waves to be on screen at all
-					if(waves[i]->getColor() < 0.0){
-						delete waves[i];
+					if(waves[i]->getColor() < 0.0 || waves[i]->isFinished()){
+						if(waves[i]->isRecording()){
+							PathKey key = {waves[i]->getProfile(), waves[i]->getOriginX(), waves[i]->getOriginY()};
+							int ticket = waves[i]->getRecordTicket();
+
+							paths.insert(key, waves[i]->takeRecording(), ticket);
+						}
+
+						spare(waves[i]);
 						waves.erase(waves.begin()+i);
-					}
+					} else particles += waves[i]->getSize();
 				}
 			}
 
+			liveParticles = particles;
+			Profiler::get().gauge(COUNTER_WAVES, waves.size());
+			Profiler::get().gauge(COUNTER_PARTICLES, particles);
+
 			SDL_UnlockMutex(waveMutex);
 		}
 	}
 
-	void renderWaves(){
+	void renderWaves(DrawList &frame, Camera *camera=NULL){
+		PROFILE_SCOPE("Waves::renderWaves");
+		ALLOC_SCOPE(ALLOC_FRAME);
+
 		if(SDL_LockMutex(waveMutex)==0){
 			for(int i=waves.size()-1; i >=0; i--){
-				waves[i]->render();
+				waves[i]->render(frame, camera);
 			}
 			
 			SDL_UnlockMutex(waveMutex);
 		}
 	}
+
+	~Waves(){
+		deleteWaves();
+		for (auto w:spares) delete w;
+		SDL_DestroyMutex(waveMutex);
+	}
 };
\ No newline at end of file
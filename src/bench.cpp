@@ -0,0 +1,328 @@
+#include <iostream>
+#include <SDL.h>
+#include <SDL_mixer.h>
+#include <vector>
+#include <map>
+#include <math.h>
+#include <string>
+#include <SDL_mutex.h>
+
+#include "Exception.hpp"
+#include "MediaManager.hpp"
+#include "Particle.hpp"
+#include "Animation.hpp"
+#include "Wave.hpp"
+#include "Player.hpp"
+#include "EntityStore.hpp"
+#include "FlowField.hpp"
+#include "AcousticField.hpp"
+#include "Config.hpp"
+#include "Tile.hpp"
+#include "Map.hpp"
+#include "LevelGenerator.hpp"
+#include "Bench.hpp"
+
+using namespace std;
+
+//Microbenchmarks for the simulation hot paths. Everything runs against a headless MediaManager
+//so no display or audio device is needed. Run from the repository root: ./bin/bench [filter]
+
+//Lays count tiles out 40 to a row (one screen wide) with an empty row between each, so the level grows downward
+vector<Tile *> makeTiles(TileArchetype *kind, int count){
+	vector<Tile *> tiles;
+	int tileW = kind->w;
+	int cols = 1280/tileW;
+
+	for(int i=0; i<count; i++){
+		Tile *t = new Tile(kind, TILE_FLOOR, (i%cols)*tileW, (i/cols)*2*tileW);
+		tiles.push_back(t);
+	}
+
+	return tiles;
+}
+
+void deleteTiles(vector<Tile *> &tiles){
+	for(auto t:tiles) delete t;
+	tiles.clear();
+}
+
+//Waves that never fade and start with every particle, so the live count stays fixed for the whole run.
+//None of them merge and their particles lose no energy, so every wave asked for is simulated and none is retired
+void fillWaves(Waves &waves, int count){
+	static WaveProfile steady = {NULL, 100, 0.8, 1e12, 0, 3, MAX_WAVE_PARTICLES, 5,
+		0, 0, 0, 1,
+		0, 0};
+
+	for(int i=0; i<count; i++)
+		waves.createWave(&steady, 64+(i*37)%1150, 64+(i*53)%600);
+}
+
+int main(int argc, char* argv[]){
+	try{
+		Bench bench(argc > 1 ? argv[1] : "");
+		MediaManager media(NULL, true);
+		Config tileConf("tile");
+		TileArchetype tileKind(&media, &tileConf);
+		Config playerConf("player");
+
+		int waveCounts[] = {1, 10, 50, 100, 250, 500};
+		for(int n:waveCounts){
+			if(!bench.enabled("Wave::update")) break;
+
+			Waves waves(&media, NULL);
+			fillWaves(waves, n);
+
+			bench.run("Wave::update", n, [&]{ waves.updateWaves(0.01); });
+			waves.deleteWaves();
+		}
+
+		//One footstep from creation until it fades, starting from a few particles or from every one
+		int startCounts[] = {8, 16, MAX_WAVE_PARTICLES};
+		for(int n:startCounts){
+			if(!bench.enabled("Wave::lifetime")) break;
+
+			Waves waves(&media, NULL);
+			WaveProfile footstep = *waves.profile("footstep");
+			footstep.particles = n;
+
+			bench.run("Wave::lifetime", n, [&]{
+				waves.createWave(&footstep, 640, 360);
+				while(waves.size() > 0) waves.updateWaves(0.01);
+			});
+
+			//Inside a one screen level, where particles that reach its margin are retired
+			waves.setBound(-32, -32, 1312, 752);
+			bench.run("Wave::lifetime bounded", n, [&]{
+				waves.createWave(&footstep, 1200, 360);
+				while(waves.size() > 0) waves.updateWaves(0.01);
+			});
+		}
+
+		int tileCounts[] = {10, 100, 1000, 10000};
+		for(int n:tileCounts){
+			if(!bench.enabled("Waves::collideGrid")) break;
+
+			Waves waves(&media, NULL);
+			fillWaves(waves, 10);
+			vector<Tile *> tiles = makeTiles(&tileKind, n);
+			TileGrid grid(stoi(tileConf["width"]));
+			grid.build(tiles);
+
+			bench.run("Waves::collideGrid", n, [&]{ waves.collideGrid(grid); });
+
+			waves.deleteWaves();
+			deleteTiles(tiles);
+		}
+
+		for(int n:tileCounts){
+			if(!bench.enabled("Character::collisions")) break;
+
+			Waves waves(&media, NULL);
+			Player player(&media, NULL, &waves, &playerConf, 640, 300);
+			vector<Tile *> tiles = makeTiles(&tileKind, n);
+			TileGrid grid(stoi(tileConf["width"]));
+			grid.build(tiles);
+
+			//Each op drops the player onto the second floor row from the same spot, so every op sweeps and lands
+			bench.run("Character::collisions", n, [&]{
+				player.setX(640);
+				player.setY(0);
+				player.setVY(400);
+				player.update(0.05);
+				player.collisions(grid);
+			});
+
+			waves.deleteWaves();
+			deleteTiles(tiles);
+		}
+
+		if(bench.enabled("Character::update")){
+			Waves waves(&media, NULL);
+			Player player(&media, NULL, &waves, &playerConf, 640, 300);
+			player.moveRight();
+
+			//Walking on a tile picks the walk animation every tick and drops a footstep every second
+			bench.run("Character::update walking", 1, [&]{
+				player.setX(640);
+				player.update(0.01);
+				if(waves.size() > 64) waves.deleteWaves();
+			});
+		}
+
+		int entityCounts[] = {10, 100, 1000, 10000};
+		for(int n:entityCounts){
+			if(!bench.enabled("EntityStore::update")) break;
+
+			Waves waves(&media, NULL);
+			Config npcConf("npc");
+			EntityArchetype npcType(&media, &waves, &npcConf);
+			EntityStore npcs(&waves, true, true);
+			vector<Tile *> tiles = makeTiles(&tileKind, 100);
+			TileGrid grid(stoi(tileConf["width"]));
+			grid.build(tiles);
+
+			FlowField flow(&grid, npcType.h, npcType.baseSpeed, npcType.jumpSpeed);
+			flow.setTarget(640, 30, 20, 34);
+			npcType.flow = &flow;
+
+			for(int i=0; i<n; i++) npcs.create(&npcType, (i*7)%1200, 64);
+
+			bench.run("EntityStore::update", n, [&]{ npcs.update(0.01, 640, 30, grid); });
+
+			waves.deleteWaves();
+			deleteTiles(tiles);
+		}
+
+		for(int n:tileCounts){
+			if(!bench.enabled("FlowField::setTarget")) break;
+
+			//A hole at alternate ends of each floor makes one zigzag route from the top of the level to the bottom
+			vector<Tile *> tiles = makeTiles(&tileKind, n);
+			int tileW = stoi(tileConf["width"]);
+			int cols = 1280/tileW;
+			for(int i=tiles.size()-1; i>=cols; i--){
+				if(i%cols == ((i/cols)%2 ? 1 : cols-2)){
+					delete tiles[i];
+					tiles.erase(tiles.begin()+i);
+				}
+			}
+
+			TileGrid grid(tileW);
+			grid.build(tiles);
+			FlowField flow(&grid, tileW, 40, -50);
+			int bottom = tiles.back()->getY()-tileW;
+
+			//Alternates between two cells on the bottom floor so every op is a full retarget
+			bool side = false;
+			bench.run("FlowField::setTarget", n, [&]{
+				side = !side;
+				flow.setTarget(side ? 0 : tiles.back()->getX(), bottom, tileW, tileW);
+			});
+
+			deleteTiles(tiles);
+		}
+
+		for(int n:tileCounts){
+			if(!bench.enabled("AcousticField")) break;
+
+			vector<Tile *> tiles = makeTiles(&tileKind, n);
+			TileGrid grid(stoi(tileConf["width"]));
+			grid.build(tiles);
+
+			bench.run("AcousticField::build", n, [&]{ AcousticField field(&grid); });
+
+			AcousticField field(&grid);
+			int i = 0;
+			bench.run("AcousticField::pathLength", n, [&]{
+				i = (i+97)%1280;
+				field.pathLength(i, 40, 1280-i, 40+(i%3)*64);
+			});
+
+			deleteTiles(tiles);
+		}
+
+		if(bench.enabled("Particle::collide")){
+			vector<Tile *> tiles = makeTiles(&tileKind, 1);
+			Particle p(0, 0, 100, 45, 0, 0, 0.8);
+
+			bench.run("Particle::collide miss", 1, [&]{
+				p.setX(600);
+				p.setY(600);
+				p.collide(tiles[0]);
+			});
+			bench.run("Particle::collide hit", 1, [&]{
+				p.setX(10);
+				p.setY(10);
+				p.collide(tiles[0]);
+			});
+
+			deleteTiles(tiles);
+		}
+
+		string animationNames[] = {"block", "walkLeft", "static"};
+		for(auto name:animationNames){
+			if(!bench.enabled("Animation::getFrame")) break;
+
+			Animation a;
+			a.readAnimation(&media, name);
+
+			ifstream in("media/animations/" + name + ".txt");
+			int frameCount;
+			in >> frameCount;
+
+			bench.run("Animation::getFrame", frameCount, [&]{
+				a.update(0.016);
+				a.getFrame();
+			});
+		}
+
+		if(bench.enabled("Config")){
+			bench.run("Config::operator[]", 1, [&]{ playerConf["baseSpeed"]; });
+			bench.run("Config::getMany", 5, [&]{ playerConf.getMany("animations"); });
+		}
+
+		for(int level=1; level<=3; level++){
+			if(!bench.enabled("Map::initMap")) break;
+
+			Waves waves(&media, NULL);
+
+			bench.run("Map::initMap level" + to_string(level), level, [&]{
+				Map *m = new Map(&media, NULL, &waves, NULL);
+				m->initMap(level);
+				delete m;
+			});
+		}
+
+		//Generated levels ten times wider than tall, up to the largest the generator makes
+		int generatedCols[] = {400, 2000, GEN_MAX_COLS};
+		for(int cols:generatedCols){
+			if(!bench.enabled("generated")) break;
+
+			LevelGenSpec spec;
+			LevelGenerator::parse("gen:1:" + to_string(cols) + "x" + to_string(cols/10), spec);
+
+			bench.run("LevelGenerator::write generated", cols, [&]{ LevelGenerator(spec).write(); });
+
+			string filename = LevelGenerator(spec).write();
+			Waves waves(&media, NULL);
+			bench.run("Map::loadLevel generated", cols, [&]{
+				Map *m = new Map(&media, NULL, &waves, NULL);
+				m->loadLevel(filename);
+				delete m;
+			});
+
+			//One tick of the player walking right through the level, as MyGame::update runs it
+			Map *m = new Map(&media, NULL, &waves, NULL);
+			m->setStreaming(25, true);
+			m->loadLevel(filename);
+			Player player(&media, NULL, &waves, &playerConf, m->getStartX(), m->getStartY());
+			m->applyBound(&player);
+			player.moveRight();
+
+			bench.run("Map::update generated", cols, [&]{
+				player.update(0.01);
+				m->update(0.01, &player);
+				if(player.getX() > m->getWidth()-256) player.setX(m->getStartX());
+			});
+
+			delete m;
+			waves.deleteWaves();
+			remove(filename.c_str());
+		}
+
+		if(bench.enabled("MediaManager")){
+			bench.run("MediaManager::readImage cold", 1, [&]{
+				MediaManager cold(NULL, true);
+				cold.readImage("walkLeft");
+			});
+
+			MediaManager warm(NULL, true);
+			bench.run("MediaManager::readImage warm", 1, [&]{ warm.readImage("walkLeft"); });
+		}
+	} catch(Exception e){
+		cerr << e;
+		return 1;
+	}
+
+	return 0;
+}
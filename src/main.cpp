@@ -5,22 +5,31 @@
 #include <vector>
 #include <map>
 #include <math.h>
+#include <climits>
 #include <string>
 #include <SDL_mutex.h>
 
 #include "Exception.hpp"
 #include "MediaManager.hpp"
+#include "Replay.hpp"
+#include "Profiler.hpp"
+#include "AllocTracker.hpp"
+#include "Latency.hpp"
+#include "SoakTest.hpp"
+#include "SpscQueue.hpp"
+#include "DrawList.hpp"
 #include "Game.hpp"
 #include "Particle.hpp"
 #include "Animation.hpp"
 #include "Wave.hpp"
 #include "Player.hpp"
-#include "NPC.hpp"
-#include "Key.hpp"
+#include "EntityStore.hpp"
 #include "Config.hpp"
 #include "Tile.hpp"
 #include "Map.hpp"
 #include "Menus.hpp"
+#include "Camera.hpp"
+#include "FileWatcher.hpp"
 
 
 using namespace std;
@@ -33,26 +42,77 @@ class MyGame:public Game{
 
 	Map *level;
 	int currentLevel;
+	unsigned long long seed;
+
+	//level=gen:<seed>:<cols>x<rows> plays generated levels instead of the shipped ones, level N using seed+N-1
+	bool generated;
+	LevelGenSpec generatedSpec;
 
 	Mix_Chunk *backgroundMusic;
 
 	Animation *tvStatic;
 	SDL_Rect *staticDest;
 
+	Camera camera;
+	TextRenderer *hudText; //NULL when headless
+	int throttleRadius, throttleInterval;
+	int chunkCache;
+
+	LevelSnapshot *respawn; //the level as it was when the player entered it, put back when they die
+
+	FileWatcher *watcher; //content directories, NULL unless hotReload=1
+
+	WaveProfile *soakSounds[2]; //what the soak test's waves sound like, resolved once
+
 	public:
-	MyGame(Config &gameConf):Game(gameConf["name"], stoi(gameConf["screenW"]), stoi(gameConf["screenH"])){
+	MyGame(Config &gameConf, bool headless=false):Game(gameConf["name"], stoi(gameConf["screenW"]), stoi(gameConf["screenH"]), headless),
+		camera(stoi(gameConf["screenW"]), stoi(gameConf["screenH"])){
 		backgroundMusic = media->readSound(gameConf["backgroundMusic"]);
 
-		waves = new Waves(ren);
+		waves = new Waves(media, ren);
+
+		//A replay brings its own seed, otherwise seed=0 in game.conf picks a fresh one each run
+		if(gameConf["replay"]!="") replay.play(gameConf["replay"]);
+		else{
+			seed = stoull(gameConf["seed"]);
+			if(seed==0) seed = SDL_GetPerformanceCounter();
+
+			if(gameConf["record"]!="") replay.record(gameConf["record"], seed);
+		}
+		if(replay.isPlaying()) seed = replay.getSeed();
+
+		traceFile = gameConf["profileTrace"];
+		Profiler::get().setEnabled(gameConf["profile"]=="1" || traceFile!="");
+
+		latencyReport = gameConf["latencyReport"];
+		latency.setEnabled(gameConf["latency"]=="1" || latencyReport!="");
+
+		//Counting needs operator new hooked, which only the memory build (make memory) does
+		memoryReport = gameConf["memoryReport"];
+		if((gameConf["memory"]=="1" || memoryReport!="") && !AllocTracker::isAvailable())
+			cerr << "memory=1 needs a build with TRACK_ALLOCATIONS, see make memory" << endl;
+		AllocTracker::get().setEnabled(gameConf["memory"]=="1" || memoryReport!="");
+
+		throttleRadius = stoi(gameConf["throttleRadius"]);
+		throttleInterval = stoi(gameConf["throttleInterval"]);
+		chunkCache = stoi(gameConf["chunkCache"]);
+
+		generated = LevelGenerator::parse(gameConf["level"], generatedSpec);
+
+		soak.configure(gameConf, seed);
+		soakSounds[0] = waves->profile("footstep");
+		soakSounds[1] = waves->profile("clap");
+		if(soak.isEnabled() && generated && stoi(gameConf["soakNpcs"]) > 0) generatedSpec.npcs = stoi(gameConf["soakNpcs"]);
 
 		currentLevel = 1;
-		level = new Map(media, ren, waves, NULL);
-		level->initMap(currentLevel);
+		level = newLevel(currentLevel);
 
 		playerConf = new Config("player");
 		player = new Player(media, ren, waves, playerConf, level->getStartX(), level->getStartY());
+		level->applyBound(player);
+		respawn = level->checkpoint(player);
 
-		Mix_PlayChannel(-1,backgroundMusic,-1);
+		media->playSound(backgroundMusic, -1);
 
 		//This block is for initing the static effect
 		tvStatic = new Animation(100);
@@ -64,19 +124,49 @@ class MyGame:public Game{
 		staticDest->w = stoi(gameConf["screenW"]);
 		staticDest->h = stoi(gameConf["screenH"]);
 
-		SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
+		//Recordings and replays must see the same content from start to end, so they never reload
+		watcher = NULL;
+		if(gameConf["hotReload"]=="1" && !replay.isRecording() && !replay.isPlaying()){
+			watcher = new FileWatcher();
+			watcher->watch("config");
+			watcher->watch("levels");
+			watcher->watch("media/animations");
+		}
+
+		hudText = NULL;
+		if(!headless){
+			SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
+			hudText = new TextRenderer(ren, DEFAULT_FONT, 12);
+		}
+	}
+
+	//Chunks stream in on a background thread during live play. Headless runs, recordings and replays read them
+	//on the physics thread so every run sees the same chunks on the same tick
+	Map *newLevel(int levelNum){
+		Map *m = new Map(media, ren, waves, NULL, seed);
+
+		m->setThrottle(throttleRadius, throttleInterval);
+		m->setStreaming(chunkCache, headless || replay.isRecording() || replay.isPlaying());
+		if(generated){
+			LevelGenSpec spec = generatedSpec;
+			spec.seed += levelNum-1;
+			m->initGenerated(spec);
+		} else m->initMap(levelNum);
+
+		return m;
 	}
 
 	void levelChange(int levelNum){
-		Map *oldLevel = level;
+		levelReport();
 
-		Map *newLevel = new Map(media, ren, waves, NULL);
+		Map *oldLevel = level;
+		Map *loaded = newLevel(levelNum);
 
-		newLevel->initMap(levelNum);
-		level = newLevel;
+		level = loaded;
 
 		player->setX(level->getStartX());
 		player->setY(level->getStartY());
+		level->applyBound(player);
 
 		delete oldLevel;
 
@@ -84,11 +174,102 @@ class MyGame:public Game{
 
 		player->setHasKey(false);
 		player->setHasLeft(false);
+
+		delete respawn;
+		respawn = level->checkpoint(player);
+	}
+
+	//How many headless ticks to run, a soak test stopping itself after soakSeconds
+	int soakTicks(int ticks){ return soak.isEnabled() ? INT_MAX : ticks; }
+
+	//Whether a soak test stayed within its budgets, true when none ran
+	bool soakReport(){ return soak.report(cout); }
+
+	//Heap use while the current level was played
+	void levelReport(){
+		writeMemoryReport("level " + to_string(currentLevel));
+	}
+
+	//The current level is built again from its file, the player staying where they are and keeping the key
+	void reloadLevel(){
+		double x = player->getX(), y = player->getY();
+		bool hasKey = player->getHasKey();
+
+		levelChange(currentLevel);
+
+		player->setX(x);
+		player->setY(y);
+		player->setHasKey(hasKey);
+	}
+
+	//Main thread: applies whatever content was saved since the last call. The game is paused while it does,
+	//since reloads create textures and replace what the physics thread reads. A file that fails to load is
+	//reported and the game carries on with what it had
+	void reloadContent(){
+		if(!watcher) return;
+
+		vector<string> changed = watcher->poll();
+		if(changed.empty()) return;
+
+		pause();
+		hotReload(changed);
+		resume();
+	}
+
+	void hotReload(const vector<string> &changed){
+		for(auto &path:changed){
+			size_t slash = path.rfind('/'), dot = path.rfind('.');
+			if(dot == string::npos || dot < slash) continue;
+
+			string dir = path.substr(0, slash), name = path.substr(slash+1, dot-slash-1), ext = path.substr(dot+1);
+
+			try{
+				bool applied = false;
+
+				if(dir == "config" && ext == "conf"){
+					if(name == "player"){
+						playerConf->reload([&]{ player->configure(); });
+						applied = true;
+					} else if(name == "waves"){
+						waves->reloadProfiles();
+						applied = true;
+					} else applied = level->reloadConfig(name);
+				} else if(dir == "media/animations" && ext == "txt"){
+					applied = media->reloadAnimation(name);
+				} else if(dir == "levels" && ext == "txt" && name == "level"+to_string(currentLevel)){
+					reloadLevel();
+					applied = true;
+				}
+
+				if(applied) cout << "Reloaded " << path << endl;
+			} catch(Exception e){
+				cerr << "Could not reload " << path << ". " << e;
+			} catch(exception &e){
+				cerr << "Could not reload " << path << ". " << e.what() << endl;
+			}
+		}
+	}
+
+	//Starts the soak test's waves for this tick anywhere within a screen of the view, so they collide with
+	//tiles that are loaded and are drawn or culled the way a real crowd's would be
+	void soakWaves(double dt){
+		SDL_Rect view = camera.view();
+
+		int x0 = max(0, view.x-view.w), x1 = min(level->getWidth(), view.x+2*view.w);
+		int y0 = max(0, view.y-view.h), y1 = min(level->getHeight(), view.y+2*view.h);
+
+		for(int n=soak.due(dt); n>0; n--)
+			waves->createWave(soakSounds[soak.range(2)], x0+soak.range(x1-x0), y0+soak.range(y1-y0));
 	}
 
 	void update(double dt){
+		PROFILE_SCOPE("MyGame::update");
+
+		if(soak.isEnabled()) soakWaves(dt);
+
 		player->update(dt);
 		level->update(dt, player);
+		soak.setLoad(waves->size(), waves->getParticles());
 
 		tvStatic->update(dt);
 
@@ -99,22 +280,54 @@ class MyGame:public Game{
 			levelChange(currentLevel+1);
 		}
 
-		if(player->getY()>=player->getMaxY()){
-			player->setVY(0);
+		//Dying only rewinds the level in memory, the level file is not read again
+		if(player->getY()>=player->getMaxY()) level->restore(*respawn, player);
+	}
+
+	unsigned long long stateHash(){
+		unsigned long long h = 14695981039346656037ULL;
 
-			levelChange(currentLevel);
-		}
+		h = hashMix(h, currentLevel);
+		h = hashMix(h, player->getX());
+		h = hashMix(h, player->getY());
+
+		return level->stateHash(h);
+	}
+
+	void buildFrame(DrawList &frame){
+		camera.follow(player->getDest(), level->getWidth(), level->getHeight());
+
+		frame.sprite(tvStatic->getTexture(), tvStatic->getFrame(), *staticDest, tvStatic->getTransparency());
+		level->render(frame, player, &camera);
 	}
 
-	void render(){
+	void render(DrawList &frame){
 		SDL_RenderClear(ren);
-		SDL_RenderCopy(ren, tvStatic->getTexture(), tvStatic->getFrame(), staticDest);
+		frame.draw(ren);
 
-		level->render(player);
-		  
+		Profiler::get().renderOverlay(ren, hudText);
+
+		PROFILE_SCOPE("SDL_RenderPresent");
 		SDL_RenderPresent(ren);
 	}
 
+	bool handleUiKey(SDL_Event keyEvent){
+		//The simulation sleeps while the menu is up, quitting from it ends the game
+		if(keyEvent.type==SDL_KEYDOWN && keyEvent.key.keysym.sym==SDLK_m){
+			pause();
+			if(pauseMenu()==1) is_running = false;
+			resume();
+			return true;
+		}
+
+		if(keyEvent.type==SDL_KEYDOWN && keyEvent.key.keysym.sym==SDLK_F3){
+			Profiler::get().toggleOverlay();
+			return true;
+		}
+
+		return false;
+	}
+
 	void handleKeyUp(SDL_Event keyEvent){
 		switch(keyEvent.key.keysym.sym){
 			case SDLK_LEFT:
@@ -156,9 +369,6 @@ class MyGame:public Game{
 			case SDLK_e:
 				player->clap();
 				break;
-			case SDLK_m:
-				pauseMenu();
-				break;
 			case SDLK_1:
 				levelChange(1);
 				break;
@@ -174,24 +384,41 @@ class MyGame:public Game{
 	}
 
 	~MyGame(){
+		delete watcher;
+		delete respawn;
+		delete level;
 		delete player;
-		delete waves;	
+		delete waves;
+		delete hudText;
 	}
 };
 
 int main(int argc, char* argv[]){
+	bool passed = true;
+
+	try{
+		Config gameConf("game");
+
+		//Arguments are key=value and override game.conf, e.g. headless=1 headlessTicks=10000 record=session.replay
+		for(int i=1; i<argc; i++) gameConf.parseLine(argv[i]);
 
-	int startGame = mainMenu();
-	if(startGame==1){
-		try{
-			Config gameConf("game");
+		if(gameConf["headless"]=="1"){
+			MyGame g(gameConf, true);
 
+			//A soak test runs for soakSeconds instead of headlessTicks
+			g.runHeadless(g.soakTicks(stoi(gameConf["headlessTicks"])), stod(gameConf["headlessDt"]));
+			g.levelReport();
+			passed = g.soakReport();
+		} else if(mainMenu()==1){
 			MyGame g(gameConf);
 
 			g.run();
-		} catch(Exception e){
-			cerr << e;
+			g.levelReport();
+			passed = g.soakReport();
 		}
+	} catch(Exception e){
+		cerr << e;
+		passed = false;
 	}
-    return 0;
+    return passed ? 0 : 1;
 }
\ No newline at end of file